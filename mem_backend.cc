@@ -0,0 +1,151 @@
+#include "mem_backend.h"
+#include "sim_pipe.h"
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+/* =============================================================
+
+   FIXED LATENCY BACKEND
+
+   ============================================================= */
+
+fixed_latency_backend::fixed_latency_backend(unsigned latency){
+	this->latency = latency;
+}
+
+unsigned fixed_latency_backend::access(unsigned address, bool write, unsigned cycle){
+	return latency;
+}
+
+void fixed_latency_backend::reset(){
+}
+
+mem_backend *fixed_latency_backend::clone(){
+	return new fixed_latency_backend(latency);
+}
+
+void fixed_latency_backend::print_stats(){
+	cout << "Fixed latency memory: " << dec << latency << " cycles" << endl;
+}
+
+string fixed_latency_backend::describe(){
+	ostringstream s;
+	s << "fixed " << latency;
+	return s.str();
+}
+
+/* =============================================================
+
+   DRAM BACKEND
+
+   ============================================================= */
+
+dram_backend::dram_backend(dram_config_t config){
+	if (config.channels == 0 || config.banks == 0 || config.row_size == 0){
+		cerr << "error: DRAM needs at least one channel, one bank and a non-empty row" << endl;
+		exit(-1);
+	}
+	this->config = config;
+	banks = new dram_bank_t[config.channels * config.banks];
+	reset();
+}
+
+dram_backend::~dram_backend(){
+	delete [] banks;
+}
+
+dram_bank_t *dram_backend::bank_of(unsigned channel, unsigned bank){
+	return &banks[channel * config.banks + bank];
+}
+
+/* returns the latency of the access: row hit = tCAS, precharged bank = tRCD+tCAS, row conflict = tRP+tRCD+tCAS, plus the time the bank is still busy */
+unsigned dram_backend::access(unsigned address, bool write, unsigned cycle){
+	unsigned frame = address / config.row_size;
+	unsigned channel = frame % config.channels;
+	unsigned bank = (frame / config.channels) % config.banks;
+	unsigned row = frame / (config.channels * config.banks);
+	dram_bank_t *b = bank_of(channel, bank);
+
+	unsigned start = (b->busy_until > cycle) ? b->busy_until : cycle;
+	unsigned service;
+	if (b->open_row == row){
+		service = config.tCAS;
+		b->row_hits++;
+	} else if (b->open_row == UNDEFINED){
+		service = config.tRCD + config.tCAS;
+		b->row_empty++;
+	} else {
+		service = config.tRP + config.tRCD + config.tCAS;
+		b->row_conflicts++;
+	}
+	unsigned latency = start - cycle + service;
+
+	if (config.policy == OPEN_PAGE){
+		b->open_row = row;
+		b->busy_until = start + service;
+	} else {
+		// the precharge after the access keeps the bank busy but is off the critical path
+		b->open_row = UNDEFINED;
+		b->busy_until = start + service + config.tRP;
+	}
+	b->accesses++;
+	b->total_latency += latency;
+	return latency;
+}
+
+void dram_backend::reset(){
+	for (unsigned i=0; i<config.channels * config.banks; i++){
+		banks[i].open_row = UNDEFINED;
+		banks[i].busy_until = 0;
+		banks[i].accesses = 0;
+		banks[i].row_hits = 0;
+		banks[i].row_empty = 0;
+		banks[i].row_conflicts = 0;
+		banks[i].total_latency = 0;
+	}
+}
+
+mem_backend *dram_backend::clone(){
+	dram_backend *copy = new dram_backend(config);
+	for (unsigned i=0; i<config.channels * config.banks; i++) copy->banks[i] = banks[i];
+	return copy;
+}
+
+void dram_backend::print_stats(){
+	ios::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
+	cout << "DRAM: " << dec << config.channels << " channel(s) x " << config.banks << " bank(s), row size " << config.row_size
+	     << ", tRCD/tCAS/tRP = " << config.tRCD << "/" << config.tCAS << "/" << config.tRP
+	     << ", " << (config.policy == OPEN_PAGE ? "open" : "closed") << " page" << endl;
+	for (unsigned c=0; c<config.channels; c++)
+		for (unsigned b=0; b<config.banks; b++){
+			if (get_accesses(c, b) == 0) continue;
+			cout << "channel " << c << " bank " << b << ": accesses = " << get_accesses(c, b)
+			     << " row hits = " << get_row_hits(c, b)
+			     << " row conflicts = " << get_row_conflicts(c, b)
+			     << " average latency = " << fixed << setprecision(2) << get_average_latency(c, b) << endl;
+		}
+	cout.flags(flags);
+	cout.precision(precision);
+}
+
+string dram_backend::describe(){
+	ostringstream s;
+	s << "dram " << config.channels << " " << config.banks << " " << config.row_size << " " << config.tRCD << " " << config.tCAS << " " << config.tRP << " " << config.policy;
+	return s.str();
+}
+
+unsigned dram_backend::get_accesses(unsigned channel, unsigned bank){return bank_of(channel, bank)->accesses;}
+
+unsigned dram_backend::get_row_hits(unsigned channel, unsigned bank){return bank_of(channel, bank)->row_hits;}
+
+unsigned dram_backend::get_row_conflicts(unsigned channel, unsigned bank){return bank_of(channel, bank)->row_conflicts;}
+
+float dram_backend::get_average_latency(unsigned channel, unsigned bank){
+	dram_bank_t *b = bank_of(channel, bank);
+	return b->accesses ? (float)b->total_latency / b->accesses : 0;
+}
@@ -0,0 +1,105 @@
+#ifndef MEM_BACKEND_H_
+#define MEM_BACKEND_H_
+
+#include <stdio.h>
+#include <string>
+
+using namespace std;
+
+/*
+Timing model of the data memory behind the MEM stage.
+The simulator asks the backend for the latency of every access it issues;
+the data itself always lives in the simulator's data_memory.
+*/
+class mem_backend{
+
+public:
+
+	virtual ~mem_backend(){}
+
+	//returns the latency (in clock cycles) of an access to "address" issued at clock cycle "cycle", and updates the state of the model
+	virtual unsigned access(unsigned address, bool write, unsigned cycle)=0;
+
+	//resets the timing state and the statistics of the model
+	virtual void reset()=0;
+
+	//returns a copy of the model (configuration and state)
+	virtual mem_backend *clone()=0;
+
+	//prints the statistics of the model
+	virtual void print_stats()=0;
+
+	//returns a description of the configuration (used to key cached simulation results)
+	virtual string describe()=0;
+};
+
+/* every access takes the same number of clock cycles (the original data_memory_latency behaviour) */
+class fixed_latency_backend : public mem_backend{
+
+	unsigned latency;
+
+public:
+
+	fixed_latency_backend(unsigned latency);
+
+	unsigned access(unsigned address, bool write, unsigned cycle);
+	void reset();
+	mem_backend *clone();
+	void print_stats();
+	string describe();
+};
+
+typedef enum {OPEN_PAGE, CLOSED_PAGE} page_policy_t;
+
+/*
+DRAM configuration (timings in clock cycles)
+Address mapping: | row | bank | channel | column |, with row_size bytes per row
+*/
+typedef struct{
+	unsigned channels;
+	unsigned banks; //banks per channel
+	unsigned row_size; //bytes per row
+	unsigned tRCD; //activate to column command
+	unsigned tCAS; //column command to data
+	unsigned tRP; //precharge
+	page_policy_t policy; //OPEN_PAGE: rows stay open until a conflict; CLOSED_PAGE: rows are precharged after every access
+} dram_config_t;
+
+/* state and statistics of a DRAM bank */
+typedef struct{
+	unsigned open_row; //UNDEFINED if the bank is precharged
+	unsigned busy_until; //first clock cycle in which the bank can accept a new command
+	unsigned accesses;
+	unsigned row_hits;
+	unsigned row_empty; //accesses to a precharged bank
+	unsigned row_conflicts;
+	unsigned long long total_latency;
+} dram_bank_t;
+
+/* DRAM with channels, banks and a row-buffer policy: the latency of an access depends on its address and on the previous accesses */
+class dram_backend : public mem_backend{
+
+	dram_config_t config;
+	dram_bank_t *banks; //channels*banks entries, channel-major
+
+	dram_bank_t *bank_of(unsigned channel, unsigned bank);
+
+public:
+
+	dram_backend(dram_config_t config);
+	~dram_backend();
+
+	unsigned access(unsigned address, bool write, unsigned cycle);
+	void reset();
+	mem_backend *clone();
+	void print_stats();
+	string describe();
+
+	//per-bank statistics
+	unsigned get_accesses(unsigned channel, unsigned bank);
+	unsigned get_row_hits(unsigned channel, unsigned bank);
+	unsigned get_row_conflicts(unsigned channel, unsigned bank);
+	float get_average_latency(unsigned channel, unsigned bank);
+};
+
+#endif /*MEM_BACKEND_H_*/
@@ -0,0 +1,91 @@
+#include "sim_pipe.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/* =============================================================
+
+   DATA MEMORY IMAGES
+
+   ============================================================= */
+
+/* the data memory is an anonymous mapping (rather than a heap array) so that an image file can be mapped over it
+   without changing its address, which devices and other engines keep */
+void sim_pipe::allocate_data_memory(){
+	if (data_memory_size == 0){
+		data_memory = NULL;
+		return;
+	}
+	void *m = mmap(NULL, data_memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (m == MAP_FAILED){
+		cerr << "error: allocation of " << data_memory_size << " bytes of data memory failed!" << endl;
+		exit(-1);
+	}
+	data_memory = (unsigned char *) m;
+}
+
+/* unmaps the data memory, including the images mapped over it */
+void sim_pipe::release_data_memory(){
+	if (data_memory != NULL) munmap(data_memory, data_memory_size);
+	data_memory = NULL;
+}
+
+void sim_pipe::load_memory_image(const char *filename, unsigned address){
+	unsigned page = sysconf(_SC_PAGESIZE);
+	if (address % page != 0){
+		cerr << "error: a data memory image must be loaded at a multiple of the page size (" << page << " bytes)" << endl;
+		exit(-1);
+	}
+	int fd = open(filename, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0){
+		cerr << "error: open file " << filename << " failed!" << endl;
+		exit(-1);
+	}
+	unsigned size = st.st_size;
+	if (st.st_size > data_memory_size || address > data_memory_size - size){
+		cerr << "error: image " << filename << " (" << size << " bytes) does not fit in the data memory at address 0x" << hex << address << dec << endl;
+		exit(-1);
+	}
+	if (size == 0){
+		close(fd);
+		return;
+	}
+
+	// the last page of the mapping extends past the end of the file: its remaining bytes keep their content
+	unsigned tail = (size % page != 0) ? page - size % page : 0;
+	if (address + size + tail > data_memory_size) tail = data_memory_size - address - size;
+	unsigned char *saved = new unsigned char[tail + 1];
+	memcpy(saved, data_memory + address + size, tail);
+
+	// private mapping: the pages are read from the file when first accessed and copied when first written
+	if (mmap(data_memory + address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED){
+		cerr << "error: mapping of image " << filename << " failed!" << endl;
+		exit(-1);
+	}
+	close(fd);
+	memcpy(data_memory + address + size, saved, tail);
+	delete [] saved;
+}
+
+void sim_pipe::dump_memory(const char *filename, unsigned start_address, unsigned end_address){
+	if (start_address > end_address || end_address > data_memory_size){
+		cerr << "error: invalid data memory range 0x" << hex << start_address << ":0x" << end_address << dec << endl;
+		exit(-1);
+	}
+	FILE *file = fopen(filename, "wb");
+	if (file == NULL){
+		cerr << "error: open file " << filename << " failed!" << endl;
+		exit(-1);
+	}
+	if (fwrite(data_memory + start_address, 1, end_address - start_address, file) != end_address - start_address || fclose(file) != 0){
+		cerr << "error: write to file " << filename << " failed!" << endl;
+		exit(-1);
+	}
+}
@@ -0,0 +1,119 @@
+#include "mem_trace.h"
+#include "sim_pipe.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/* =============================================================
+
+   MEMORY ACCESS TRACE
+
+   ============================================================= */
+
+static void put_word(unsigned char *bytes, unsigned value){
+	for (unsigned i=0; i<4; i++) bytes[i] = (value >> (8*i)) & 0xFF;
+}
+
+static unsigned get_word(const unsigned char *bytes){
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned) bytes[3] << 24);
+}
+
+void mem_trace_encode(const mem_trace_record_t *record, unsigned char *bytes){
+	put_word(bytes, record->cycle);
+	put_word(bytes + 4, record->pc);
+	put_word(bytes + 8, record->address);
+	bytes[12] = record->size;
+	bytes[13] = record->write;
+}
+
+void mem_trace_decode(const unsigned char *bytes, mem_trace_record_t *record){
+	record->cycle = get_word(bytes);
+	record->pc = get_word(bytes + 4);
+	record->address = get_word(bytes + 8);
+	record->size = bytes[12];
+	record->write = bytes[13];
+}
+
+trace_writer::trace_writer(const char *filename){
+	file = fopen(filename, "wb");
+	if (file == NULL){
+		cerr << "error: open file " << filename << " failed!" << endl;
+		exit(-1);
+	}
+	if (fwrite(MEM_TRACE_MAGIC, 1, strlen(MEM_TRACE_MAGIC), file) != strlen(MEM_TRACE_MAGIC)){
+		cerr << "error: write to file " << filename << " failed!" << endl;
+		exit(-1);
+	}
+	fill = new unsigned char[MEM_TRACE_BUFFER_RECORDS * MEM_TRACE_RECORD_SIZE];
+	flush = new unsigned char[MEM_TRACE_BUFFER_RECORDS * MEM_TRACE_RECORD_SIZE];
+	fill_records = 0;
+	flush_records = 0;
+	stopping = 0;
+	writer = thread(&trace_writer::write_loop, this);
+}
+
+trace_writer::~trace_writer(){
+	if (fill_records > 0) hand_over();
+	{
+		unique_lock<mutex> l(lock);
+		stopping = 1;
+		cond.notify_all();
+	}
+	writer.join();
+	fclose(file);
+	delete [] fill;
+	delete [] flush;
+}
+
+void trace_writer::append(const mem_trace_record_t *record){
+	mem_trace_encode(record, fill + fill_records * MEM_TRACE_RECORD_SIZE);
+	if (++fill_records == MEM_TRACE_BUFFER_RECORDS) hand_over();
+}
+
+/* passes the fill buffer to the writer thread, waiting for it to finish the previous one */
+void trace_writer::hand_over(){
+	unique_lock<mutex> l(lock);
+	while (flush_records > 0) cond.wait(l);
+	unsigned char *full = fill;
+	fill = flush;
+	flush = full;
+	flush_records = fill_records;
+	fill_records = 0;
+	cond.notify_all();
+}
+
+/* body of the writer thread: writes the buffers handed over until the writer is destroyed */
+void trace_writer::write_loop(){
+	unique_lock<mutex> l(lock);
+	while (1){
+		while (flush_records == 0 && !stopping) cond.wait(l);
+		if (flush_records == 0) return;
+		unsigned records = flush_records;
+		l.unlock();
+		if (fwrite(flush, MEM_TRACE_RECORD_SIZE, records, file) != records){
+			cerr << "error: write of the memory trace failed!" << endl;
+			exit(-1);
+		}
+		l.lock();
+		flush_records = 0;
+		cond.notify_all();
+	}
+}
+
+void sim_pipe::set_mem_trace(const char *filename){
+	delete mem_trace;
+	mem_trace = (filename != NULL) ? new trace_writer(filename) : NULL;
+}
+
+/* records the access entering the MEM stage in the next clock cycle */
+void sim_pipe::trace_access(opcode_t opcode, unsigned address, unsigned pc){
+	mem_trace_record_t record;
+	record.cycle = clock_cycles+1;
+	record.pc = pc;
+	record.address = address;
+	record.size = 4;
+	record.write = (opcode == SW);
+	mem_trace->append(&record);
+}
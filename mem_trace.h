@@ -0,0 +1,67 @@
+#ifndef MEM_TRACE_H_
+#define MEM_TRACE_H_
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/*
+Binary trace of the data memory accesses (sim_pipe::set_mem_trace).
+
+File layout (little-endian): the 8-byte header MEM_TRACE_MAGIC, then one MEM_TRACE_RECORD_SIZE-byte record per
+LW/SW entering the MEM stage: cycle (4 bytes), PC (4), effective address (4), size in bytes (1), 1 for a SW (1).
+
+Records are appended to a buffer in memory; full buffers are handed to a writer thread, so the simulation only
+waits for the disk if both buffers are full.
+*/
+
+#define MEM_TRACE_MAGIC "MEMTRC01"
+#define MEM_TRACE_RECORD_SIZE 14
+#define MEM_TRACE_BUFFER_RECORDS 65536
+
+typedef struct{
+	unsigned cycle;
+	unsigned pc;
+	unsigned address;
+	unsigned char size;
+	unsigned char write;
+} mem_trace_record_t;
+
+/* encodes/decodes a record (MEM_TRACE_RECORD_SIZE bytes) */
+void mem_trace_encode(const mem_trace_record_t *record, unsigned char *bytes);
+void mem_trace_decode(const unsigned char *bytes, mem_trace_record_t *record);
+
+class trace_writer{
+
+	FILE *file;
+
+	//double buffering: the simulator fills "fill" while the writer thread writes "flush"
+	unsigned char *fill;
+	unsigned fill_records;
+	unsigned char *flush;
+	unsigned flush_records; //0 = the writer thread is idle
+
+	int stopping;
+	mutex lock;
+	condition_variable cond;
+	thread writer;
+
+	void write_loop();
+	void hand_over();
+
+public:
+
+	//opens "filename" for writing and starts the writer thread
+	trace_writer(const char *filename);
+
+	//writes the buffered records, stops the writer thread and closes the file
+	~trace_writer();
+
+	//appends a record
+	void append(const mem_trace_record_t *record);
+};
+
+#endif /*MEM_TRACE_H_*/
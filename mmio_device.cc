@@ -0,0 +1,168 @@
+#include "mmio_device.h"
+#include "sim_pipe.h"
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+
+using namespace std;
+
+/* =============================================================
+
+   EVENT SCHEDULER
+
+   ============================================================= */
+
+event_scheduler::event_scheduler(){
+	sequence = 0;
+}
+
+void event_scheduler::schedule(unsigned cycle, mmio_device *device, unsigned tag){
+	event_t e;
+	e.cycle = cycle;
+	e.sequence = sequence++;
+	e.device = device;
+	e.tag = tag;
+	events.push(e);
+}
+
+unsigned event_scheduler::next_event(){
+	return events.empty() ? UNDEFINED : events.top().cycle;
+}
+
+unsigned event_scheduler::fire(unsigned cycle){
+	unsigned fired = 0;
+	while (!events.empty() && events.top().cycle <= cycle){
+		event_t e = events.top();
+		events.pop();
+		e.device->event(e.cycle, e.tag); //may schedule further events
+		fired++;
+	}
+	return fired;
+}
+
+void event_scheduler::clear(){
+	while (!events.empty()) events.pop();
+	sequence = 0;
+}
+
+/* =============================================================
+
+   MEMORY-MAPPED DEVICES
+
+   ============================================================= */
+
+mmio_device::mmio_device(unsigned latency){
+	this->latency = latency;
+	scheduler = NULL;
+	memory = NULL;
+	memory_size = 0;
+}
+
+void mmio_device::attach(event_scheduler *s, unsigned char *data_memory, unsigned data_memory_size){
+	scheduler = s;
+	memory = data_memory;
+	memory_size = data_memory_size;
+}
+
+/* periodic timer */
+
+timer_device::timer_device(unsigned latency) : mmio_device(latency){
+	generation = 0;
+	reset();
+}
+
+unsigned timer_device::read(unsigned offset, unsigned cycle){
+	switch(offset){
+		case 0x0: return period;
+		case 0x4: return ticks;
+		default: return 0;
+	}
+}
+
+void timer_device::write(unsigned offset, unsigned value, unsigned cycle){
+	if (offset == 0x4) ticks = value;
+	if (offset != 0x0) return;
+	period = value;
+	ticks = 0;
+	generation++;
+	if (period > 0) scheduler->schedule(cycle + period, this, generation);
+}
+
+void timer_device::event(unsigned cycle, unsigned tag){
+	if (tag != generation || period == 0) return;
+	ticks++;
+	scheduler->schedule(cycle + period, this, generation);
+}
+
+void timer_device::reset(){
+	period = 0;
+	ticks = 0;
+	generation++;
+}
+
+string timer_device::describe(){
+	ostringstream s;
+	s << "timer " << latency;
+	return s.str();
+}
+
+/* DMA engine */
+
+dma_device::dma_device(unsigned latency, unsigned setup, unsigned bytes_per_cycle) : mmio_device(latency){
+	if (bytes_per_cycle == 0){
+		cerr << "error: the DMA engine needs a non-zero bandwidth" << endl;
+		exit(-1);
+	}
+	this->setup = setup;
+	this->bytes_per_cycle = bytes_per_cycle;
+	reset();
+}
+
+unsigned dma_device::read(unsigned offset, unsigned cycle){
+	switch(offset){
+		case 0x0: return src;
+		case 0x4: return dst;
+		case 0x8: return len;
+		case 0xC: return busy;
+		default: return 0;
+	}
+}
+
+void dma_device::write(unsigned offset, unsigned value, unsigned cycle){
+	switch(offset){
+		case 0x0: src = value; break;
+		case 0x4: dst = value; break;
+		case 0x8: len = value; break;
+		case 0xC:
+			if (value != 1 || busy) break;
+			busy = 1;
+			scheduler->schedule(cycle + setup + (len + bytes_per_cycle - 1) / bytes_per_cycle, this);
+			break;
+		default: break;
+	}
+}
+
+void dma_device::event(unsigned cycle, unsigned tag){
+	if (len > memory_size || src > memory_size - len || dst > memory_size - len){
+		cerr << "error: DMA transfer of " << len << " bytes from 0x" << hex << src << " to 0x" << dst << dec << " outside the data memory" << endl;
+		exit(-1);
+	}
+	memmove(&memory[dst], &memory[src], len);
+	busy = 0;
+	transfers++;
+}
+
+void dma_device::reset(){
+	src = dst = len = 0;
+	busy = 0;
+	transfers = 0;
+}
+
+string dma_device::describe(){
+	ostringstream s;
+	s << "dma " << latency << " " << setup << " " << bytes_per_cycle;
+	return s.str();
+}
+
+unsigned dma_device::get_transfers(){return transfers;}
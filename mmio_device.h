@@ -0,0 +1,157 @@
+#ifndef MMIO_DEVICE_H_
+#define MMIO_DEVICE_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <queue>
+
+using namespace std;
+
+class mmio_device;
+
+/* event scheduled by a device: "device->event(cycle, tag)" is called at the beginning of clock cycle "cycle" */
+typedef struct{
+	unsigned cycle;
+	unsigned sequence; //events of the same clock cycle fire in the order they were scheduled
+	mmio_device *device;
+	unsigned tag;
+} event_t;
+
+struct event_later{
+	bool operator()(const event_t &a, const event_t &b) const{
+		return (a.cycle != b.cycle) ? a.cycle > b.cycle : a.sequence > b.sequence;
+	}
+};
+
+/*
+Discrete-event scheduler (priority queue ordered by clock cycle) shared by the devices attached to a simulator.
+The simulator fires the events of each clock cycle before its pipeline stages, and uses the time of the next
+event to skip the clock cycles in which neither the pipeline nor the devices change state.
+*/
+class event_scheduler{
+
+	priority_queue<event_t, vector<event_t>, event_later> events;
+	unsigned sequence;
+
+public:
+
+	event_scheduler();
+
+	//schedules device->event(cycle, tag)
+	void schedule(unsigned cycle, mmio_device *device, unsigned tag=0);
+
+	//returns the clock cycle of the next event (UNDEFINED if there is none)
+	unsigned next_event();
+
+	//fires, in order, all the events scheduled up to clock cycle "cycle"; returns their number
+	unsigned fire(unsigned cycle);
+
+	//removes all the events
+	void clear();
+};
+
+/*
+Memory-mapped device: LW/SW to its address range are routed to read()/write() (offsets from the base of the range,
+word aligned for reads) and wait "latency" clock cycles in the MEM stage instead of accessing the data memory.
+A device can schedule events and access the data memory of the simulator it is attached to.
+*/
+class mmio_device{
+
+protected:
+
+	unsigned latency;
+	event_scheduler *scheduler; //set when attached
+	unsigned char *memory; //data memory of the simulator (set when attached)
+	unsigned memory_size;
+
+public:
+
+	mmio_device(unsigned latency);
+	virtual ~mmio_device(){}
+
+	//called by the simulator when the device is attached
+	void attach(event_scheduler *s, unsigned char *data_memory, unsigned data_memory_size);
+
+	unsigned get_latency(){ return latency; }
+
+	//returns the 32-bit register at (word aligned) "offset"
+	virtual unsigned read(unsigned offset, unsigned cycle)=0;
+
+	//writes "value" to the register at "offset"
+	virtual void write(unsigned offset, unsigned value, unsigned cycle)=0;
+
+	//handles an event scheduled by the device
+	virtual void event(unsigned cycle, unsigned tag)=0;
+
+	//resets registers and statistics (the pending events are removed by the simulator)
+	virtual void reset()=0;
+
+	//returns a description of the configuration (used to key cached simulation results)
+	virtual string describe()=0;
+};
+
+/*
+Periodic timer
+offset 0x0 PERIOD (R/W): writing a non-zero value (re)starts the timer, which expires every PERIOD clock cycles; 0 stops it
+offset 0x4 TICKS (R/W): number of expirations since the timer was started (or last written)
+*/
+class timer_device : public mmio_device{
+
+	unsigned period;
+	unsigned ticks;
+	unsigned generation; //tags the events of the current period (the ones of a previous one are ignored)
+
+public:
+
+	timer_device(unsigned latency=1);
+
+	unsigned read(unsigned offset, unsigned cycle);
+	void write(unsigned offset, unsigned value, unsigned cycle);
+	void event(unsigned cycle, unsigned tag);
+	void reset();
+	string describe();
+};
+
+/*
+DMA engine copying a block of the data memory
+offset 0x0 SRC, 0x4 DST, 0x8 LEN (bytes) (R/W)
+offset 0xC CTRL/STATUS: writing 1 starts the transfer, which completes "setup" + LEN/"bytes_per_cycle" clock cycles later
+            (the data is copied at completion); reads 1 while the transfer is in progress, 0 otherwise
+*/
+class dma_device : public mmio_device{
+
+	unsigned setup;
+	unsigned bytes_per_cycle;
+	unsigned src, dst, len;
+	int busy;
+	unsigned transfers;
+
+public:
+
+	dma_device(unsigned latency=1, unsigned setup=4, unsigned bytes_per_cycle=4);
+
+	unsigned read(unsigned offset, unsigned cycle);
+	void write(unsigned offset, unsigned value, unsigned cycle);
+	void event(unsigned cycle, unsigned tag);
+	void reset();
+	string describe();
+
+	//returns the number of completed transfers
+	unsigned get_transfers();
+};
+
+/* address range of an attached device */
+typedef struct{
+	unsigned base;
+	unsigned size;
+	mmio_device *device;
+} mmio_range_t;
+
+/* devices attached to a simulator (sim_pipe::attach_device) */
+typedef struct mmio_state{
+	event_scheduler scheduler;
+	vector<mmio_range_t> ranges;
+} mmio_state_t;
+
+#endif /*MMIO_DEVICE_H_*/
@@ -0,0 +1,189 @@
+#include "prefetcher.h"
+#include "sim_pipe.h"
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+prefetcher::prefetcher(unsigned line_size){
+	if (line_size == 0){
+		cerr << "error: the prefetch line size must be non-zero" << endl;
+		exit(-1);
+	}
+	this->line_size = line_size;
+}
+
+/* =============================================================
+
+   NEXT-LINE PREFETCHER
+
+   ============================================================= */
+
+next_line_prefetcher::next_line_prefetcher(unsigned line_size, unsigned degree) : prefetcher(line_size){
+	this->degree = degree;
+}
+
+unsigned next_line_prefetcher::observe(unsigned pc, unsigned address, bool write, unsigned *requests, unsigned max){
+	unsigned n = 0;
+	for (unsigned i=1; i<=degree && n<max; i++) requests[n++] = line_of(address) + i * line_size;
+	return n;
+}
+
+void next_line_prefetcher::reset(){
+}
+
+prefetcher *next_line_prefetcher::clone(){
+	return new next_line_prefetcher(line_size, degree);
+}
+
+string next_line_prefetcher::describe(){
+	ostringstream s;
+	s << "next_line " << line_size << " " << degree;
+	return s.str();
+}
+
+/* =============================================================
+
+   STRIDE PREFETCHER
+
+   ============================================================= */
+
+stride_prefetcher::stride_prefetcher(unsigned line_size, unsigned table_size, unsigned degree) : prefetcher(line_size){
+	this->table_size = (table_size > 0) ? table_size : 1;
+	this->degree = degree;
+	table = new stride_entry_t[this->table_size];
+	reset();
+}
+
+stride_prefetcher::~stride_prefetcher(){
+	delete [] table;
+}
+
+unsigned stride_prefetcher::observe(unsigned pc, unsigned address, bool write, unsigned *requests, unsigned max){
+	stride_entry_t *e = &table[(pc / 4) % table_size];
+	if (e->pc != pc){
+		// new instruction: (re)allocate the entry
+		e->pc = pc;
+		e->last_address = address;
+		e->stride = 0;
+		e->confidence = 0;
+		return 0;
+	}
+	int stride = address - e->last_address;
+	if (stride == e->stride){
+		if (e->confidence < 3) e->confidence++;
+	} else {
+		if (e->confidence > 0) e->confidence--;
+		if (e->confidence == 0) e->stride = stride;
+	}
+	e->last_address = address;
+	unsigned n = 0;
+	if (e->confidence >= 2 && e->stride != 0){
+		unsigned last = line_of(address);
+		for (unsigned i=1; i<=degree && n<max; i++){
+			unsigned line = line_of(address + i * e->stride);
+			if (line == last) continue; //strides shorter than a line
+			requests[n++] = line;
+			last = line;
+		}
+	}
+	return n;
+}
+
+void stride_prefetcher::reset(){
+	for (unsigned i=0; i<table_size; i++){
+		table[i].pc = UNDEFINED;
+		table[i].last_address = 0;
+		table[i].stride = 0;
+		table[i].confidence = 0;
+	}
+}
+
+prefetcher *stride_prefetcher::clone(){
+	stride_prefetcher *copy = new stride_prefetcher(line_size, table_size, degree);
+	for (unsigned i=0; i<table_size; i++) copy->table[i] = table[i];
+	return copy;
+}
+
+string stride_prefetcher::describe(){
+	ostringstream s;
+	s << "stride " << line_size << " " << table_size << " " << degree;
+	return s.str();
+}
+
+/* =============================================================
+
+   STREAM PREFETCHER
+
+   ============================================================= */
+
+stream_prefetcher::stream_prefetcher(unsigned line_size, unsigned num_streams, unsigned distance) : prefetcher(line_size){
+	this->num_streams = (num_streams > 0) ? num_streams : 1;
+	this->distance = distance;
+	streams = new stream_entry_t[this->num_streams];
+	reset();
+}
+
+stream_prefetcher::~stream_prefetcher(){
+	delete [] streams;
+}
+
+unsigned stream_prefetcher::observe(unsigned pc, unsigned address, bool write, unsigned *requests, unsigned max){
+	unsigned line = line_of(address);
+	accesses++;
+
+	// look for a stream this line continues (same line, or the next one in either direction)
+	stream_entry_t *s = NULL;
+	for (unsigned i=0; i<num_streams && s == NULL; i++){
+		stream_entry_t *c = &streams[i];
+		if (c->last_line == UNDEFINED) continue;
+		if (line == c->last_line || line == c->last_line + line_size || line == c->last_line - line_size) s = c;
+	}
+
+	if (s == NULL){
+		// allocate a new stream, replacing the least recently used one
+		s = &streams[0];
+		for (unsigned i=1; i<num_streams; i++)
+			if (streams[i].last_line == UNDEFINED || (s->last_line != UNDEFINED && streams[i].last_use < s->last_use)) s = &streams[i];
+		s->last_line = line;
+		s->direction = 0;
+		s->last_use = accesses;
+		return 0;
+	}
+
+	s->last_use = accesses;
+	if (line == s->last_line) return 0;
+	int direction = (line > s->last_line) ? 1 : -1;
+	// a stream is confirmed by two consecutive moves in the same direction
+	int confirmed = (s->direction == direction);
+	s->direction = direction;
+	s->last_line = line;
+	if (!confirmed) return 0;
+
+	unsigned n = 0;
+	for (unsigned i=1; i<=distance && n<max; i++) requests[n++] = line + direction * (int)(i * line_size);
+	return n;
+}
+
+void stream_prefetcher::reset(){
+	for (unsigned i=0; i<num_streams; i++){
+		streams[i].last_line = UNDEFINED;
+		streams[i].direction = 0;
+		streams[i].last_use = 0;
+	}
+	accesses = 0;
+}
+
+prefetcher *stream_prefetcher::clone(){
+	stream_prefetcher *copy = new stream_prefetcher(line_size, num_streams, distance);
+	for (unsigned i=0; i<num_streams; i++) copy->streams[i] = streams[i];
+	copy->accesses = accesses;
+	return copy;
+}
+
+string stream_prefetcher::describe(){
+	ostringstream s;
+	s << "stream " << line_size << " " << num_streams << " " << distance;
+	return s.str();
+}
@@ -0,0 +1,108 @@
+#ifndef PREFETCHER_H_
+#define PREFETCHER_H_
+
+#include <stdio.h>
+#include <string>
+
+using namespace std;
+
+/*
+Data prefetcher: observes the LW/SW address stream of the MEM stage (effective address and PC of the memory instruction)
+and returns the addresses of the lines to bring into the simulator's prefetch buffer.
+*/
+class prefetcher{
+
+protected:
+
+	unsigned line_size; //bytes per prefetched line
+
+	unsigned line_of(unsigned address){ return address - address % line_size; }
+
+public:
+
+	prefetcher(unsigned line_size);
+	virtual ~prefetcher(){}
+
+	unsigned get_line_size(){ return line_size; }
+
+	//observes a demand access and writes at most "max" line addresses to prefetch into "requests"; returns their number
+	virtual unsigned observe(unsigned pc, unsigned address, bool write, unsigned *requests, unsigned max)=0;
+
+	//resets the training state
+	virtual void reset()=0;
+
+	//returns a copy of the prefetcher (configuration and state)
+	virtual prefetcher *clone()=0;
+
+	//returns a description of the configuration (used to key cached simulation results)
+	virtual string describe()=0;
+};
+
+/* prefetches the "degree" lines following the accessed one */
+class next_line_prefetcher : public prefetcher{
+
+	unsigned degree;
+
+public:
+
+	next_line_prefetcher(unsigned line_size, unsigned degree=1);
+
+	unsigned observe(unsigned pc, unsigned address, bool write, unsigned *requests, unsigned max);
+	void reset();
+	prefetcher *clone();
+	string describe();
+};
+
+/* entry of the stride prefetcher reference prediction table */
+typedef struct{
+	unsigned pc; //UNDEFINED if the entry is free
+	unsigned last_address;
+	int stride;
+	unsigned confidence; //saturating counter (0-3): prefetch when >= 2
+} stride_entry_t;
+
+/* PC-indexed stride prefetcher: once a memory instruction repeats the same stride, prefetches "degree" strides ahead */
+class stride_prefetcher : public prefetcher{
+
+	unsigned table_size;
+	unsigned degree;
+	stride_entry_t *table;
+
+public:
+
+	stride_prefetcher(unsigned line_size, unsigned table_size=16, unsigned degree=2);
+	~stride_prefetcher();
+
+	unsigned observe(unsigned pc, unsigned address, bool write, unsigned *requests, unsigned max);
+	void reset();
+	prefetcher *clone();
+	string describe();
+};
+
+/* stream tracked by the stream prefetcher */
+typedef struct{
+	unsigned last_line; //UNDEFINED if the stream is free
+	int direction; //+1 ascending, -1 descending, 0 not confirmed yet
+	unsigned last_use; //for LRU replacement
+} stream_entry_t;
+
+/* stream prefetcher: detects ascending or descending sequences of line accesses and runs "distance" lines ahead of them */
+class stream_prefetcher : public prefetcher{
+
+	unsigned num_streams;
+	unsigned distance;
+	stream_entry_t *streams;
+	unsigned accesses;
+
+public:
+
+	stream_prefetcher(unsigned line_size, unsigned num_streams=4, unsigned distance=4);
+	~stream_prefetcher();
+
+	unsigned observe(unsigned pc, unsigned address, bool write, unsigned *requests, unsigned max);
+	void reset();
+	prefetcher *clone();
+	string describe();
+};
+
+#endif /*PREFETCHER_H_*/
@@ -0,0 +1,177 @@
+#include "result_cache.h"
+#include "mem_backend.h"
+#include "prefetcher.h"
+#include "sim_icache.h"
+#include "mmio_device.h"
+#include "sim_btc.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <atomic>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/* =============================================================
+
+   RESULT CACHE
+
+   ============================================================= */
+
+#define FNV_PRIME 0x100000001b3ULL
+
+void result_key_init(result_key_t *key){
+	key->h1 = 0xcbf29ce484222325ULL; //standard FNV-1a offset basis
+	key->h2 = 0x84222325cbf29ce4ULL; //second, independent stream
+}
+
+void result_key_update(result_key_t *key, const void *data, unsigned size){
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (unsigned i=0; i<size; i++){
+		key->h1 = (key->h1 ^ bytes[i]) * FNV_PRIME;
+		key->h2 = (key->h2 ^ (unsigned char)(bytes[i] + i)) * FNV_PRIME;
+	}
+}
+
+static void result_key_update(result_key_t *key, unsigned value){
+	result_key_update(key, &value, sizeof(value));
+}
+
+static void result_key_update(result_key_t *key, string s){
+	result_key_update(key, s.size());
+	result_key_update(key, s.data(), s.size());
+}
+
+/* hashes program, initial state and configuration of the simulator */
+void sim_pipe::cache_key(result_key_t *key){
+	result_key_init(key);
+	result_key_update(key, string(RESULT_CACHE_MAGIC));
+
+	// program: the fields are hashed one by one (no struct padding, no labels); instructions after EOP are never fetched
+	result_key_update(key, instr_base_address);
+	if (start_pc() != instr_base_address) result_key_update(key, start_pc()); //fast-forwarded by run_translated
+	for (unsigned i=0; i<PROGRAM_SIZE; i++){
+		instruction_t *instr = &instr_memory[i];
+		result_key_update(key, instr->opcode);
+		result_key_update(key, instr->src1);
+		result_key_update(key, instr->src2);
+		result_key_update(key, instr->dest);
+		result_key_update(key, instr->immediate);
+		if (instr->opcode == EOP) break;
+	}
+
+	// initial state
+	for (unsigned i=0; i<NUM_GP_REGISTERS; i++) result_key_update(key, (unsigned) gp_registers[i]);
+	result_key_update(key, data_memory_size);
+	result_key_update(key, data_memory, data_memory_size);
+
+	// configuration
+	result_key_update(key, data_memory_latency);
+	result_key_update(key, backend->describe());
+	result_key_update(key, data_prefetcher != NULL ? data_prefetcher->describe() : string("none"));
+	result_key_update(key, prefetch_buffer_size);
+	result_key_update(key, num_mshrs);
+	result_key_update(key, store_buffer_size);
+	result_key_update(key, icache != NULL ? icache->size : 0);
+	if (icache != NULL){
+		result_key_update(key, icache->line_size);
+		result_key_update(key, icache->assoc);
+		result_key_update(key, icache->miss_latency);
+		result_key_update(key, icache->buffer_lines);
+	}
+	result_key_update(key, mmio != NULL ? (unsigned) mmio->ranges.size() : 0);
+	for (unsigned i=0; mmio != NULL && i<mmio->ranges.size(); i++){
+		result_key_update(key, mmio->ranges[i].base);
+		result_key_update(key, mmio->ranges[i].size);
+		result_key_update(key, mmio->ranges[i].device->describe());
+	}
+	// the replayed timing is approximate with a mem_backend: the results are kept apart from the ones simulated in detail
+	if (btc != NULL){
+		result_key_update(key, string("block timing"));
+		result_key_update(key, btc->resample);
+	}
+}
+
+bool sim_pipe::run_cached(const char *cache_dir, bool save_state){
+
+	// only complete runs from the initial state can be looked up
+	if (clock_cycles != 0){
+		run();
+		return false;
+	}
+
+	result_key_t key;
+	cache_key(&key);
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx%016llx", key.h1, key.h2);
+	string path = string(cache_dir) + "/" + name;
+
+	/* ============   LOOKUP   ============  */
+	FILE *f = fopen(path.c_str(), "rb");
+	if (f != NULL){
+		result_header_t header;
+		bool hit = (fread(&header, sizeof(header), 1, f) == 1
+		            && strncmp(header.magic, RESULT_CACHE_MAGIC, sizeof(header.magic)) == 0
+		            && header.key.h1 == key.h1 && header.key.h2 == key.h2
+		            && header.data_memory_size == data_memory_size
+		            && (header.has_state || !save_state));
+		int registers[NUM_GP_REGISTERS];
+		unsigned char *memory = NULL;
+		if (hit && header.has_state){
+			memory = new unsigned char[data_memory_size];
+			hit = (fread(registers, sizeof(registers), 1, f) == 1 && fread(memory, data_memory_size, 1, f) == 1);
+		}
+		fclose(f);
+		if (hit){
+			clock_cycles = header.clock_cycles;
+			instructions_executed = header.instructions_executed;
+			stalls = header.stalls;
+			if (header.has_state){
+				memcpy(gp_registers, registers, sizeof(registers));
+				memcpy(data_memory, memory, data_memory_size);
+			}
+		}
+		delete [] memory;
+		if (hit) return true;
+	}
+
+	/* ============   SIMULATE AND STORE   ============  */
+	run();
+
+	// a run stopped by the lockstep check is not a complete simulation
+	if (get_divergence_cycle() != UNDEFINED) return false;
+
+	if (mkdir(cache_dir, 0777) != 0 && errno != EEXIST){
+		cerr << "warning: cannot create result cache directory " << cache_dir << endl;
+		return false;
+	}
+	// unique temporary name, renamed into place once complete (rename is atomic within a file system)
+	static atomic<unsigned> sequence(0); //shared by the simulators running in other threads (see sim_server.cc)
+	char suffix[64];
+	snprintf(suffix, sizeof(suffix), ".tmp.%d.%u", (int) getpid(), sequence++);
+	string temp = path + suffix;
+
+	result_header_t header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, RESULT_CACHE_MAGIC, sizeof(header.magic));
+	header.key = key;
+	header.clock_cycles = clock_cycles;
+	header.instructions_executed = instructions_executed;
+	header.stalls = stalls;
+	header.has_state = save_state;
+	header.data_memory_size = data_memory_size;
+
+	f = fopen(temp.c_str(), "wb");
+	bool written = (f != NULL && fwrite(&header, sizeof(header), 1, f) == 1);
+	if (written && save_state)
+		written = (fwrite(gp_registers, sizeof(gp_registers), 1, f) == 1 && fwrite(data_memory, data_memory_size, 1, f) == 1);
+	if (f != NULL && fclose(f) != 0) written = false;
+	if (!written || rename(temp.c_str(), path.c_str()) != 0){
+		cerr << "warning: cannot write result cache entry " << path << endl;
+		remove(temp.c_str());
+	}
+	return false;
+}
@@ -0,0 +1,41 @@
+#ifndef RESULT_CACHE_H_
+#define RESULT_CACHE_H_
+
+#include "sim_pipe.h"
+
+/*
+Persistent result cache used by sim_pipe::run_cached().
+
+A simulation is identified by a 128-bit key, hashed over:
+- the decoded program (opcode and operands of every instruction, base address)
+- the initial state (general purpose registers and data memory)
+- the configuration (memory size/latency, memory backend, prefetcher, MSHRs, store buffer, block timing cache)
+
+Every result is a file named after its key (32 hex digits) in the cache directory.
+Files are written to a temporary name and renamed into place, so that concurrent
+simulations sharing a directory never read a partially written entry.
+*/
+
+#define RESULT_CACHE_MAGIC "SIMRC02" //also acts as format version: change it when the layout or the timing model changes
+
+/* two independent 64-bit FNV-1a hashes */
+typedef struct result_key{
+	unsigned long long h1;
+	unsigned long long h2;
+} result_key_t;
+
+void result_key_init(result_key_t *key);
+void result_key_update(result_key_t *key, const void *data, unsigned size);
+
+/* header of a cache file; followed by the registers and the data memory if has_state is set */
+typedef struct{
+	char magic[8];
+	result_key_t key;
+	unsigned clock_cycles;
+	unsigned instructions_executed;
+	unsigned stalls;
+	unsigned has_state;
+	unsigned data_memory_size;
+} result_header_t;
+
+#endif /*RESULT_CACHE_H_*/
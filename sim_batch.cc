@@ -0,0 +1,368 @@
+#include "sim_batch.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SIMD_X86 //AVX2 and AVX-512 kernels, compiled for their own target and selected at run time
+#endif
+
+using namespace std;
+
+/* =============================================================
+
+   SIMD KERNELS (all the lanes on the same path)
+
+   ============================================================= */
+
+#ifdef SIMD_X86
+
+/* instruction set of the kernels supported by the processor: 2 = AVX-512, 1 = AVX2, 0 = none */
+static int simd_level(){
+	static const int level = __builtin_cpu_supports("avx512f") ? 2 : (__builtin_cpu_supports("avx2") ? 1 : 0);
+	return level;
+}
+
+/* simd_alu on 16 lanes per iteration, the last ones masked */
+__attribute__((target("avx512f")))
+static void simd_alu_avx512(opcode_t opcode, int *d, const int *a, const int *b, unsigned imm, unsigned n){
+	__m512i vimm = _mm512_set1_epi32(imm);
+	for (unsigned l=0; l<n; l+=16){
+		unsigned count = (n-l >= 16) ? 16 : n-l;
+		__mmask16 k = (__mmask16) ((1u << count) - 1);
+		__m512i va = _mm512_maskz_loadu_epi32(k, a+l);
+		__m512i vb = (b != NULL) ? _mm512_maskz_loadu_epi32(k, b+l) : vimm;
+		__m512i vd;
+		switch(opcode){
+			case ADD:
+			case ADDI:
+				vd = _mm512_add_epi32(va, vb);
+				break;
+			case SUB:
+			case SUBI:
+				vd = _mm512_sub_epi32(va, vb);
+				break;
+			default: //XOR
+				vd = _mm512_xor_si512(va, vb);
+		}
+		_mm512_mask_storeu_epi32(d+l, k, vd);
+	}
+}
+
+/* simd_alu on 8 lanes per iteration; returns the number of lanes processed */
+__attribute__((target("avx2")))
+static unsigned simd_alu_avx2(opcode_t opcode, int *d, const int *a, const int *b, unsigned imm, unsigned n){
+	unsigned l = 0;
+	__m256i vimm = _mm256_set1_epi32(imm);
+	for (; l+8<=n; l+=8){
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a+l));
+		__m256i vb = (b != NULL) ? _mm256_loadu_si256((const __m256i *)(b+l)) : vimm;
+		__m256i vd;
+		switch(opcode){
+			case ADD:
+			case ADDI:
+				vd = _mm256_add_epi32(va, vb);
+				break;
+			case SUB:
+			case SUBI:
+				vd = _mm256_sub_epi32(va, vb);
+				break;
+			default: //XOR
+				vd = _mm256_xor_si256(va, vb);
+		}
+		_mm256_storeu_si256((__m256i *)(d+l), vd);
+	}
+	return l;
+}
+
+/* simd_taken on 16 lanes per iteration, the last ones masked */
+__attribute__((target("avx512f")))
+static void simd_taken_avx512(opcode_t opcode, const int *a, unsigned char *taken, unsigned n){
+	__m512i zero = _mm512_setzero_si512();
+	for (unsigned l=0; l<n; l+=16){
+		unsigned count = (n-l >= 16) ? 16 : n-l;
+		__m512i va = _mm512_maskz_loadu_epi32((__mmask16) ((1u << count) - 1), a+l);
+		unsigned bits;
+		switch(opcode){
+			case BEQZ: bits = _mm512_cmpeq_epi32_mask(va, zero); break;
+			case BNEZ: bits = ~_mm512_cmpeq_epi32_mask(va, zero); break;
+			case BGTZ: bits = _mm512_cmpgt_epi32_mask(va, zero); break;
+			case BLEZ: bits = ~_mm512_cmpgt_epi32_mask(va, zero); break;
+			case BLTZ: bits = _mm512_cmplt_epi32_mask(va, zero); break;
+			default: /*BGEZ*/ bits = ~_mm512_cmplt_epi32_mask(va, zero);
+		}
+		for (unsigned i=0; i<count; i++) taken[l+i] = (bits >> i) & 1;
+	}
+}
+
+/* simd_taken on 8 lanes per iteration; returns the number of lanes processed */
+__attribute__((target("avx2")))
+static unsigned simd_taken_avx2(opcode_t opcode, const int *a, unsigned char *taken, unsigned n){
+	unsigned l = 0;
+	__m256i zero = _mm256_setzero_si256();
+	for (; l+8<=n; l+=8){
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a+l));
+		__m256i m;
+		int invert = 0;
+		switch(opcode){
+			case BEQZ: m = _mm256_cmpeq_epi32(va, zero); break;
+			case BNEZ: m = _mm256_cmpeq_epi32(va, zero); invert = 1; break;
+			case BGTZ: m = _mm256_cmpgt_epi32(va, zero); break;
+			case BLEZ: m = _mm256_cmpgt_epi32(va, zero); invert = 1; break;
+			case BLTZ: m = _mm256_cmpgt_epi32(zero, va); break;
+			default: /*BGEZ*/ m = _mm256_cmpgt_epi32(zero, va); invert = 1;
+		}
+		int bits = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+		if (invert) bits = ~bits;
+		for (unsigned i=0; i<8; i++) taken[l+i] = (bits >> i) & 1;
+	}
+	return l;
+}
+
+#endif
+
+/* d[l] = a[l] op b[l] (R-type) or a[l] op imm (b == NULL), for l in [0, n) */
+static void simd_alu(opcode_t opcode, int *d, const int *a, const int *b, unsigned imm, unsigned n){
+	unsigned l = 0;
+#ifdef SIMD_X86
+	if (simd_level() == 2){
+		simd_alu_avx512(opcode, d, a, b, imm, n);
+		return;
+	}
+	if (simd_level() == 1) l = simd_alu_avx2(opcode, d, a, b, imm, n);
+#endif
+	for (; l<n; l++) d[l] = alu(opcode, a[l], (b != NULL) ? b[l] : 0, imm, 0);
+}
+
+/* taken[l] = outcome of the conditional branch on a[l], for l in [0, n) */
+static void simd_taken(opcode_t opcode, const int *a, unsigned char *taken, unsigned n){
+	unsigned l = 0;
+#ifdef SIMD_X86
+	if (simd_level() == 2){
+		simd_taken_avx512(opcode, a, taken, n);
+		return;
+	}
+	if (simd_level() == 1) l = simd_taken_avx2(opcode, a, taken, n);
+#endif
+	for (; l<n; l++) taken[l] = taken_branch(opcode, a[l]);
+}
+
+/* =============================================================
+
+   BATCH ENGINE
+
+   ============================================================= */
+
+sim_batch::sim_batch(unsigned lanes, unsigned data_mem_size, unsigned data_mem_latency){
+	if (lanes == 0){
+		cerr << "error: the batch needs at least one lane" << endl;
+		exit(-1);
+	}
+	num_lanes = lanes;
+	data_memory_size = data_mem_size;
+	data_memory_latency = data_mem_latency;
+	instr_base_address = 0;
+	decoder = new sim_pipe(0, data_mem_latency);
+	registers = new int[NUM_GP_REGISTERS * lanes];
+	initial_registers = new int[NUM_GP_REGISTERS * lanes];
+	memory = new unsigned char[lanes * data_mem_size];
+	initial_memory = new unsigned char[lanes * data_mem_size];
+	clock_cycles = new unsigned[lanes];
+	stalls = new unsigned[lanes];
+	instructions_executed = new unsigned[lanes];
+	reset();
+}
+
+sim_batch::~sim_batch(){
+	delete decoder;
+	delete [] registers;
+	delete [] initial_registers;
+	delete [] memory;
+	delete [] initial_memory;
+	delete [] clock_cycles;
+	delete [] stalls;
+	delete [] instructions_executed;
+}
+
+void sim_batch::load_program(const char *filename, unsigned base_address){
+	program = filename;
+	instr_base_address = base_address;
+	decoder->load_program(filename, base_address);
+}
+
+void sim_batch::reset(){
+	for (unsigned i=0; i<NUM_GP_REGISTERS * num_lanes; i++) registers[i] = initial_registers[i] = UNDEFINED;
+	memset(memory, 0xFF, num_lanes * data_memory_size);
+	memset(initial_memory, 0xFF, num_lanes * data_memory_size);
+	for (unsigned l=0; l<num_lanes; l++) clock_cycles[l] = stalls[l] = instructions_executed[l] = 0;
+	groups.clear();
+	detailed_runs = 0;
+	fallback_lanes = 0;
+}
+
+void sim_batch::set_gp_register(unsigned lane, unsigned reg, int value){
+	registers[reg * num_lanes + lane] = initial_registers[reg * num_lanes + lane] = value;
+}
+
+/* little-endian, as sim_pipe::write_memory */
+void sim_batch::write_memory(unsigned lane, unsigned address, unsigned value){
+	memcpy(&memory[lane * data_memory_size + address], &value, sizeof value);
+	memcpy(&initial_memory[lane * data_memory_size + address], &value, sizeof value);
+}
+
+/* executes a non-branch instruction on a single lane */
+void sim_batch::execute(batch_group_t *group, instruction_t instr, unsigned lane){
+	int *r = registers + lane;
+	unsigned char *m = memory + lane * data_memory_size;
+	unsigned address;
+	switch(instr.opcode){
+		case ADD:
+		case SUB:
+		case XOR:
+			r[instr.dest * num_lanes] = alu(instr.opcode, r[instr.src1 * num_lanes], r[instr.src2 * num_lanes], 0, 0);
+			break;
+		case ADDI:
+		case SUBI:
+			r[instr.dest * num_lanes] = alu(instr.opcode, r[instr.src1 * num_lanes], 0, instr.immediate, 0);
+			break;
+		case LW:
+		case SW:
+			address = alu(instr.opcode, r[instr.src1 * num_lanes], 0, instr.immediate, 0);
+			if (data_memory_size < 4 || address > data_memory_size - 4){
+				cerr << "error: lane " << lane << " accesses address 0x" << hex << address << dec << " outside the data memory (pc 0x" << hex << group->pc << dec << ")" << endl;
+				exit(-1);
+			}
+			if (instr.opcode == LW) r[instr.dest * num_lanes] = load_word(&m[address]);
+			else memcpy(&m[address], &r[instr.src2 * num_lanes], 4);
+			break;
+		default:
+			break;
+	}
+}
+
+/* executes the next instruction of a group; a diverging branch moves the lanes that take it to a new group */
+void sim_batch::step(batch_group_t *group){
+	instruction_t instr = decoder->instr_memory[(group->pc - instr_base_address)/4];
+	opcode_t opcode = instr.opcode;
+	unsigned n = group->lanes.size();
+	int converged = (n == num_lanes); //the initial group: lanes 0..num_lanes-1 in order
+
+	if (opcode == EOP){
+		group->done = 1;
+		return;
+	}
+
+	if (!is_branch(opcode)){
+		if (converged && (is_int_r(opcode) || is_int_imm(opcode)))
+			simd_alu(opcode, &registers[instr.dest * num_lanes], &registers[instr.src1 * num_lanes],
+			         is_int_r(opcode) ? &registers[instr.src2 * num_lanes] : NULL, instr.immediate, num_lanes);
+		else
+			for (unsigned i=0; i<n; i++) execute(group, instr, group->lanes[i]);
+		group->pc += 4;
+		return;
+	}
+
+	unsigned target = alu(opcode, 0, 0, instr.immediate, group->pc + 4);
+	if (opcode == JUMP){
+		group->pc = target;
+		return;
+	}
+	vector<unsigned char> taken(n);
+	if (converged) simd_taken(opcode, &registers[instr.src1 * num_lanes], &taken[0], n);
+	else for (unsigned i=0; i<n; i++) taken[i] = taken_branch(opcode, registers[instr.src1 * num_lanes + group->lanes[i]]);
+
+	batch_group_t split;
+	split.pc = target;
+	split.done = 0;
+	vector<unsigned> not_taken;
+	for (unsigned i=0; i<n; i++){
+		if (taken[i]) split.lanes.push_back(group->lanes[i]);
+		else not_taken.push_back(group->lanes[i]);
+	}
+	if (not_taken.empty()){
+		group->pc = target;
+		return;
+	}
+	group->pc += 4;
+	if (split.lanes.empty()) return;
+	group->lanes = not_taken;
+	groups.push_back(split); //invalidates "group"
+}
+
+/* simulates a lane in detail from its initial state; the caller de-allocates the returned simulator */
+sim_pipe *sim_batch::detailed_run(unsigned lane){
+	sim_pipe *sim = new sim_pipe(data_memory_size, data_memory_latency);
+	for (unsigned i=0; i<PROGRAM_SIZE; i++) sim->instr_memory[i] = decoder->instr_memory[i];
+	sim->instr_base_address = instr_base_address;
+	for (unsigned r=0; r<NUM_GP_REGISTERS; r++) sim->set_gp_register(r, initial_registers[r * num_lanes + lane]);
+	memcpy(sim->data_memory, &initial_memory[lane * data_memory_size], data_memory_size);
+	sim->run();
+	detailed_runs++;
+	return sim;
+}
+
+/* times a group with one detailed run, and validates its functional result */
+void sim_batch::time_group(batch_group_t *group){
+	unsigned first = group->lanes[0];
+	sim_pipe *sim = detailed_run(first);
+	int valid = (memcmp(sim->data_memory, &memory[first * data_memory_size], data_memory_size) == 0);
+	for (unsigned r=0; r<NUM_GP_REGISTERS && valid; r++)
+		if (sim->get_gp_register(r) != registers[r * num_lanes + first]) valid = 0;
+
+	for (unsigned i=0; i<group->lanes.size(); i++){
+		unsigned lane = group->lanes[i];
+		if (!valid){
+			// the pipeline does not follow the architectural path: its result is the reference
+			if (i > 0){
+				delete sim;
+				sim = detailed_run(lane);
+			}
+			for (unsigned r=0; r<NUM_GP_REGISTERS; r++) registers[r * num_lanes + lane] = sim->get_gp_register(r);
+			memcpy(&memory[lane * data_memory_size], sim->data_memory, data_memory_size);
+			fallback_lanes++;
+		}
+		clock_cycles[lane] = sim->get_clock_cycles();
+		stalls[lane] = sim->get_stalls();
+		instructions_executed[lane] = sim->get_instructions_executed();
+	}
+	delete sim;
+}
+
+void sim_batch::run(){
+	groups.clear();
+	detailed_runs = 0;
+	fallback_lanes = 0;
+
+	batch_group_t all;
+	all.pc = instr_base_address;
+	all.done = 0;
+	for (unsigned l=0; l<num_lanes; l++) all.lanes.push_back(l);
+	groups.push_back(all);
+
+	// groups created by a split are appended and executed after the current one
+	for (unsigned g=0; g<groups.size(); g++){
+		while (!groups[g].done) step(&groups[g]);
+		time_group(&groups[g]);
+	}
+}
+
+int sim_batch::get_gp_register(unsigned lane, unsigned reg){return registers[reg * num_lanes + lane];}
+
+void sim_batch::print_memory(unsigned lane, unsigned start_address, unsigned end_address){
+	unsigned char *m = &memory[lane * data_memory_size];
+	print_data_memory(m, start_address, end_address);
+}
+
+unsigned sim_batch::get_clock_cycles(unsigned lane){return clock_cycles[lane];}
+
+unsigned sim_batch::get_stalls(unsigned lane){return stalls[lane];}
+
+unsigned sim_batch::get_instructions_executed(unsigned lane){return instructions_executed[lane];}
+
+float sim_batch::get_IPC(unsigned lane){return (float)instructions_executed[lane]/clock_cycles[lane];}
+
+unsigned sim_batch::get_paths(){return groups.size();}
+
+unsigned sim_batch::get_detailed_runs(){return detailed_runs;}
+
+unsigned sim_batch::get_fallback_lanes(){return fallback_lanes;}
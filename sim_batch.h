@@ -0,0 +1,104 @@
+#ifndef SIM_BATCH_H_
+#define SIM_BATCH_H_
+
+#include "sim_pipe.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+Batch simulation of one program over many inputs (lanes).
+
+With the default memory model (fixed latency, blocking memory stage) the timing of the pipeline
+depends only on the sequence of instructions executed, i.e., on the outcome of the branches, and
+not on the data values. The batch engine therefore:
+- executes the program functionally for all the lanes in lockstep; the lane state is kept in
+  structure-of-arrays layout, and while all the lanes follow the same path the ALU operations and
+  the branch conditions are evaluated with SIMD kernels (AVX-512 or AVX2, selected at run time);
+- splits the lanes into groups when a branch diverges, and steps the lanes of a split group one by one;
+- runs the detailed pipeline (sim_pipe::run) once per group, i.e., once per distinct path, on the
+  first lane of the group: its cycles, stalls and instructions apply to every lane of the group.
+The detailed run also validates the group: if its final registers or memory differ from the functional
+result (the pipeline does not follow the architectural path), every lane of the group is simulated in detail.
+*/
+
+/* lanes following the same path */
+typedef struct{
+	unsigned pc; //next instruction to execute
+	vector<unsigned> lanes;
+	int done; //EOP reached
+} batch_group_t;
+
+class sim_batch{
+
+	unsigned num_lanes;
+	unsigned data_memory_size;
+	unsigned data_memory_latency;
+
+	//program (decoded by a sim_pipe, which also runs the detailed simulations)
+	string program;
+	unsigned instr_base_address;
+	sim_pipe *decoder;
+
+	//lane state, structure-of-arrays: register r of lane l is registers[r*num_lanes+l]
+	int *registers;
+	int *initial_registers;
+	//data memory of lane l starts at memory[l*data_memory_size]
+	unsigned char *memory;
+	unsigned char *initial_memory;
+
+	//per-lane statistics
+	unsigned *clock_cycles;
+	unsigned *stalls;
+	unsigned *instructions_executed;
+
+	vector<batch_group_t> groups;
+	unsigned detailed_runs;
+	unsigned fallback_lanes;
+
+	void step(batch_group_t *group);
+	void execute(batch_group_t *group, instruction_t instr, unsigned lane);
+	sim_pipe *detailed_run(unsigned lane);
+	void time_group(batch_group_t *group);
+
+public:
+
+	//instantiates "lanes" simulators with a data memory of given size (in bytes) and latency (in clock cycles)
+	sim_batch(unsigned lanes, unsigned data_mem_size, unsigned data_mem_latency);
+
+	//de-allocates the simulators
+	~sim_batch();
+
+	//loads the assembly program in file "filename" in instruction memory at the specified address (shared by all the lanes)
+	void load_program(const char *filename, unsigned base_address=0x0);
+
+	//resets the state of all the lanes (registers to UNDEFINED, data memory to 0xFF, statistics to 0)
+	void reset();
+
+	//initial state of a lane
+	void set_gp_register(unsigned lane, unsigned reg, int value);
+	void write_memory(unsigned lane, unsigned address, unsigned value);
+
+	//runs the program to completion on all the lanes
+	void run();
+
+	//final state and statistics of a lane
+	int get_gp_register(unsigned lane, unsigned reg);
+	void print_memory(unsigned lane, unsigned start_address, unsigned end_address);
+	unsigned get_clock_cycles(unsigned lane);
+	unsigned get_stalls(unsigned lane);
+	unsigned get_instructions_executed(unsigned lane);
+	float get_IPC(unsigned lane);
+
+	//returns the number of distinct paths (groups of lanes) found by the last run
+	unsigned get_paths();
+
+	//returns the number of detailed pipeline simulations performed by the last run
+	unsigned get_detailed_runs();
+
+	//returns the number of lanes simulated in detail because their group failed validation
+	unsigned get_fallback_lanes();
+};
+
+#endif /*SIM_BATCH_H_*/
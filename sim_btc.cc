@@ -0,0 +1,191 @@
+#include "sim_btc.h"
+#include "sim_xlat.h"
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+using namespace std;
+
+/* =============================================================
+
+   BASIC-BLOCK TIMING CACHE
+
+   ============================================================= */
+
+void sim_pipe::set_block_timing(bool enable, unsigned resample){
+	delete btc;
+	btc = NULL;
+	if (!enable) return;
+	btc = new btc_state_t;
+	btc->resample = resample;
+	btc_reset();
+}
+
+void sim_pipe::btc_reset(){
+	btc->cache.clear();
+	btc->recording = 0;
+	btc->resampled_exit = NULL;
+	btc->replayed = 0;
+	btc->detailed = 0;
+	btc->resampled = 0;
+	btc->resample_error = 0;
+	btc->resample_cycles = 0;
+}
+
+void sim_pipe::save_pipeline(pipeline_snapshot_t *snapshot){
+	for (unsigned s=0; s<NUM_STAGES-1; s++) snapshot->ir[s] = ir[s];
+	memcpy(snapshot->sp_registers, sp_registers, sizeof(sp_registers));
+	snapshot->raw_hazard = raw_hazard;
+	snapshot->raw_hazard_propagate = raw_hazard_propagate;
+	snapshot->raw_hazard_propagate_2 = raw_hazard_propagate_2;
+	snapshot->control_hazard = control_hazard;
+	snapshot->control_hazard_propagate = control_hazard_propagate;
+	snapshot->control_hazard_propagate_2 = control_hazard_propagate_2;
+	snapshot->control_hazard_propagate_3 = control_hazard_propagate_3;
+	snapshot->structural_mem_hazard = structural_mem_hazard;
+	snapshot->mem_hazard_pipe_freeze = mem_hazard_pipe_freeze;
+	snapshot->latency_tracker = latency_tracker;
+	snapshot->access_latency = access_latency;
+	snapshot->pc_temp = pc_temp;
+}
+
+void sim_pipe::restore_pipeline(const pipeline_snapshot_t *snapshot){
+	for (unsigned s=0; s<NUM_STAGES-1; s++) ir[s] = snapshot->ir[s];
+	memcpy(sp_registers, snapshot->sp_registers, sizeof(sp_registers));
+	raw_hazard = snapshot->raw_hazard;
+	raw_hazard_propagate = snapshot->raw_hazard_propagate;
+	raw_hazard_propagate_2 = snapshot->raw_hazard_propagate_2;
+	control_hazard = snapshot->control_hazard;
+	control_hazard_propagate = snapshot->control_hazard_propagate;
+	control_hazard_propagate_2 = snapshot->control_hazard_propagate_2;
+	control_hazard_propagate_3 = snapshot->control_hazard_propagate_3;
+	structural_mem_hazard = snapshot->structural_mem_hazard;
+	mem_hazard_pipe_freeze = snapshot->mem_hazard_pipe_freeze;
+	latency_tracker = snapshot->latency_tracker;
+	access_latency = snapshot->access_latency;
+	pc_temp = snapshot->pc_temp;
+}
+
+/* stores the counts of the block simulated in detail since the last boundary, which ends here */
+void sim_pipe::btc_record(){
+	unsigned next = sp_registers[PC][IF] - 4;
+	unsigned cycles = clock_cycles - btc->start_cycles;
+	btc->detailed++;
+	btc_exit_t *exit = btc->resampled_exit;
+	if (exit != NULL && exit->next_pc == next){
+		btc->resampled++;
+		btc->resample_error += (cycles > exit->cycles) ? cycles - exit->cycles : exit->cycles - cycles;
+		btc->resample_cycles += cycles;
+	} else {
+		map<vector<unsigned>, btc_entry_t>::iterator it = btc->cache.find(btc->key);
+		if (it == btc->cache.end()){
+			it = btc->cache.insert(make_pair(btc->key, btc_entry_t())).first;
+			it->second.exits[0].next_pc = UNDEFINED;
+			it->second.exits[1].next_pc = UNDEFINED;
+		}
+		exit = NULL;
+		for (unsigned e=0; e<2 && exit == NULL; e++)
+			if (it->second.exits[e].next_pc == next || it->second.exits[e].next_pc == UNDEFINED) exit = &it->second.exits[e];
+		if (exit == NULL) return;
+		exit->next_pc = next;
+		exit->hits = 0;
+	}
+	exit->cycles = cycles;
+	exit->stalls = stalls - btc->start_stalls;
+	exit->instructions = instructions_executed - btc->start_instructions;
+	save_pipeline(&exit->exit);
+}
+
+/* called at the beginning of every clock cycle: at the write back of a branch, closes the block simulated in detail and */
+/* replays the following blocks while they hit in the cache ("limit": clock cycle at which run() has to return, or UNDEFINED) */
+void sim_pipe::btc_boundary(unsigned limit){
+	if (!is_branch(ir[MEM].opcode)) return;
+	if (num_mshrs > 0 || store_buffer_size > 0 || data_prefetcher != NULL || icache != NULL || mmio != NULL || check != NULL || mem_trace != NULL || energy != NULL || limit_study != NULL){
+		btc->recording = 0;
+		return;
+	}
+	// the values in the younger latches are not part of the key: they must hold bubbles
+	int clean = (ir[ID].opcode == NOP && ir[EXE].opcode == NOP);
+	if (btc->recording && clean) btc_record();
+	btc->recording = 0;
+	btc->resampled_exit = NULL;
+	if (!clean) return;
+
+	if (xlat == NULL) xlat_start(UNDEFINED);
+	xlat_context_t context = {gp_registers, data_memory, data_memory_size};
+	vector<unsigned> key(LOOP_SIGNATURE_SIZE);
+	pipeline_signature(&key[0]);
+	while (1){
+		map<vector<unsigned>, btc_entry_t>::iterator it = btc->cache.find(key);
+		if (it == btc->cache.end()) break;
+		xlat_block_t *block = xlat_translate(sp_registers[PC][IF] - 4);
+		if (block == NULL || block->exit_pc[1] == UNDEFINED) break; //not closed by a branch
+
+		// functional execution, rolled back unless the outcome of the closing branch has been seen
+		int registers[NUM_GP_REGISTERS];
+		memcpy(registers, gp_registers, sizeof(registers));
+		vector<pair<unsigned, unsigned> > stores; //address, previous word
+		unsigned index = (block->pc - instr_base_address)/4;
+		int result = XLAT_NEXT;
+		for (unsigned n=0; n<block->ops.size(); n++){
+			xlat_op_t *op = &block->ops[n];
+			if (instr_memory[index+n].opcode == SW){
+				unsigned address = (unsigned) gp_registers[op->src1] + op->immediate;
+				if (data_memory_size >= 4 && address <= data_memory_size - 4) stores.push_back(make_pair(address, load_word(&data_memory[address])));
+			}
+			result = op->handler(&context, op);
+			if (result != XLAT_NEXT) break;
+		}
+		btc_exit_t *exit = NULL;
+		if (result != XLAT_FAULT)
+			for (unsigned e=0; e<2; e++)
+				if (it->second.exits[e].next_pc == block->exit_pc[result == XLAT_TAKEN]) exit = &it->second.exits[e];
+		int resample = (exit != NULL && btc->resample > 0 && (exit->hits + 1) % btc->resample == 0);
+		if (exit == NULL || resample || (limit != UNDEFINED && clock_cycles + exit->cycles >= limit)){
+			memcpy(gp_registers, registers, sizeof(registers));
+			for (int s=stores.size()-1; s>=0; s--) write_memory(stores[s].first, stores[s].second);
+			if (resample){
+				exit->hits++;
+				btc->resampled_exit = exit;
+			}
+			break;
+		}
+		exit->hits++;
+		clock_cycles += exit->cycles;
+		stalls += exit->stalls;
+		instructions_executed += exit->instructions;
+		restore_pipeline(&exit->exit);
+		btc->replayed++;
+		pipeline_signature(&key[0]);
+	}
+
+	// detailed simulation of the block, up to the next boundary
+	btc->recording = 1;
+	btc->key = key;
+	btc->start_cycles = clock_cycles;
+	btc->start_stalls = stalls;
+	btc->start_instructions = instructions_executed;
+}
+
+unsigned long long sim_pipe::get_replayed_blocks(){return (btc != NULL) ? btc->replayed : 0;}
+
+unsigned long long sim_pipe::get_detailed_blocks(){return (btc != NULL) ? btc->detailed : 0;}
+
+float sim_pipe::get_block_timing_error(){
+	if (btc == NULL || btc->resample_cycles == 0) return 0;
+	return (float) btc->resample_error / btc->resample_cycles;
+}
+
+void sim_pipe::print_block_timing_stats(){
+	if (btc == NULL) return;
+	ios::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
+	cout << dec << "block timing cache: " << btc->cache.size() << " entries" << endl;
+	cout << "blocks: " << btc->replayed << " replayed, " << btc->detailed << " simulated in detail";
+	if (btc->replayed + btc->detailed > 0) cout << " (" << fixed << setprecision(1) << 100.0 * btc->replayed / (btc->replayed + btc->detailed) << "% replayed)";
+	cout << endl;
+	cout << "resampled: " << btc->resampled << " blocks, cycle error " << fixed << setprecision(3) << 100.0 * get_block_timing_error() << "%" << endl;
+	cout.flags(flags);
+	cout.precision(precision);
+}
@@ -0,0 +1,88 @@
+#ifndef SIM_BTC_H_
+#define SIM_BTC_H_
+
+#include "sim_pipe.h"
+#include "sim_loop.h"
+#include <vector>
+#include <map>
+
+using namespace std;
+
+/*
+Basic-block timing cache of run() (sim_pipe::set_block_timing).
+
+When a branch is about to be written back, the two younger latches hold the bubbles of the control hazard and
+IF/ID holds the first instruction of the next basic block (see sim_loop.h): the block runs from there to its
+closing branch, which is about to be written back at the next boundary. The pipeline state at a boundary is
+captured by the signature of the loop acceleration (latched opcodes, hazard bits, latency tracker, branch and
+fetch addresses), which is the key of the cache: the first time a block runs from a given state, it is
+simulated in detail and the cycles, stalls and instructions up to the next boundary are stored, with a
+snapshot of the latches there, for the first instruction that follows (one per outcome of the closing branch).
+
+On a hit, the block is executed functionally with its translation (see sim_xlat.h); if its outcome has been
+seen, the block is credited the stored counts and the latches are restored from the snapshot, else it is
+rolled back and simulated in detail. Every "resample"-th hit of an outcome is also simulated in detail and its
+counts replace the stored ones: the difference is the error of the cache.
+
+With the default memory model the timing of a block only depends on the pipeline state and the replay is
+exact. A mem_backend (e.g., a dram_backend) makes the latencies depend on the addresses and on the accesses
+before: the stored counts are then an approximation, and the backend does not see the accesses of the replayed
+blocks. The other memory models, the devices and the analyses of the instructions written back (lockstep
+check, memory trace, energy model, limit study) disable the cache.
+*/
+
+/* latches and control bits of run() at a block boundary */
+typedef struct pipeline_snapshot{
+	instruction_t ir[NUM_STAGES-1];
+	unsigned sp_registers[NUM_SP_REGISTERS][NUM_STAGES];
+	int raw_hazard;
+	int raw_hazard_propagate;
+	int raw_hazard_propagate_2;
+	int control_hazard;
+	int control_hazard_propagate;
+	int control_hazard_propagate_2;
+	int control_hazard_propagate_3;
+	int structural_mem_hazard;
+	int mem_hazard_pipe_freeze;
+	unsigned latency_tracker;
+	unsigned access_latency;
+	unsigned pc_temp;
+} pipeline_snapshot_t;
+
+/* timing of a block from a pipeline state, up to the boundary before "next_pc" */
+typedef struct{
+	unsigned next_pc; //first instruction of the following block (UNDEFINED: not seen)
+	unsigned cycles;
+	unsigned stalls;
+	unsigned instructions;
+	unsigned hits;
+	pipeline_snapshot_t exit;
+} btc_exit_t;
+
+typedef struct{
+	btc_exit_t exits[2]; //one per outcome of the closing branch
+} btc_entry_t;
+
+typedef struct btc_state{
+	//configuration
+	unsigned resample; //0 = never
+
+	map<vector<unsigned>, btc_entry_t> cache; //by pipeline signature at the entry boundary
+
+	//block simulated in detail since the last boundary
+	int recording;
+	vector<unsigned> key;
+	unsigned start_cycles;
+	unsigned start_stalls;
+	unsigned start_instructions;
+	btc_exit_t *resampled_exit; //exit whose hit is simulated in detail (NULL: miss)
+
+	//statistics
+	unsigned long long replayed; //blocks credited without detailed simulation
+	unsigned long long detailed; //blocks simulated in detail (misses and resampled hits)
+	unsigned long long resampled;
+	unsigned long long resample_error; //sum over the resampled blocks of |detailed - stored cycles|
+	unsigned long long resample_cycles; //sum over the resampled blocks of the detailed cycles
+} btc_state_t;
+
+#endif /*SIM_BTC_H_*/
@@ -0,0 +1,143 @@
+#include "sim_check.h"
+#include "mmio_device.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/* =============================================================
+
+   LOCKSTEP DIFFERENTIAL CHECK
+
+   ============================================================= */
+
+void sim_pipe::set_lockstep_check(bool enable){
+	if (check != NULL){
+		delete [] check->data_memory;
+		delete check;
+		check = NULL;
+	}
+	if (!enable) return;
+	check = new check_state_t;
+	check->data_memory = new unsigned char[data_memory_size];
+	check_reset();
+}
+
+void sim_pipe::check_reset(){
+	check->started = 0;
+	check->finished = 0;
+	check->checked = 0;
+	check->divergence_cycle = UNDEFINED;
+}
+
+unsigned sim_pipe::get_checked_instructions(){return (check != NULL) ? check->checked : 0;}
+
+unsigned sim_pipe::get_divergence_cycle(){return (check != NULL) ? check->divergence_cycle : UNDEFINED;}
+
+/* starts the reference from the architectural state of the simulator */
+void sim_pipe::check_start(){
+	memcpy(check->gp_registers, gp_registers, sizeof(gp_registers));
+	memcpy(check->data_memory, data_memory, data_memory_size);
+	check->pc = start_pc();
+	check->started = 1;
+}
+
+/* records the effect of the SW leaving the MEM stage */
+void sim_pipe::check_store(unsigned address, unsigned value){
+	check->store_address = address;
+	check->store_value = value;
+}
+
+/* reports a divergence of an architectural effect */
+static void check_report(unsigned cycle, unsigned pc, instruction_t instr, const char *what, unsigned expected, unsigned found){
+	cerr << "lockstep check: divergence at cycle " << dec << cycle << ", instruction " << opcode_name(instr.opcode);
+	cerr << " at pc 0x" << hex << pc << dec << ": " << what << " is 0x" << hex << found << ", the reference expects 0x" << expected << dec << endl;
+}
+
+/* executes the next instruction of the reference and compares it with the one written back by the pipeline */
+/* returns 0 (and reports it) at the first divergence */
+int sim_pipe::check_retire(){
+	if (!check->started || check->finished || check->divergence_cycle != UNDEFINED) return 1;
+
+	unsigned index = (check->pc - instr_base_address)/4;
+	if (check->pc < instr_base_address || index >= PROGRAM_SIZE){
+		cerr << "error: the reference fetches from address 0x" << hex << check->pc << dec << " outside the program" << endl;
+		exit(-1);
+	}
+	instruction_t instr = instr_memory[index];
+	unsigned pc = check->pc;
+	check->pc += 4;
+	check->checked++;
+
+	instruction_t *retired = &ir[MEM];
+	if (retired->opcode != instr.opcode || retired->src1 != instr.src1 || retired->src2 != instr.src2 || retired->dest != instr.dest || retired->immediate != instr.immediate){
+		cerr << "lockstep check: divergence at cycle " << dec << clock_cycles << ": " << opcode_name(retired->opcode);
+		cerr << " written back, the reference expects " << opcode_name(instr.opcode) << " at pc 0x" << hex << pc << dec << endl;
+		check->divergence_cycle = clock_cycles;
+		return 0;
+	}
+
+	int *r = check->gp_registers;
+	const char *what = NULL; //effect that diverges
+	unsigned expected = 0, found = 0;
+	switch(instr.opcode){
+		case ADD:
+		case SUB:
+		case XOR:
+		case ADDI:
+		case SUBI:
+			expected = alu(instr.opcode, r[instr.src1], is_int_r(instr.opcode) ? r[instr.src2] : 0, instr.immediate, 0);
+			found = sp_registers[ALU_OUTPUT][WB];
+			r[instr.dest] = expected;
+			if (expected != found) what = "the destination register";
+			break;
+		case LW:
+		case SW: {
+			unsigned address = alu(instr.opcode, r[instr.src1], 0, instr.immediate, 0);
+			unsigned offset;
+			int device = (find_device(address, &offset) != NULL);
+			if ((data_memory_size < 4 || address > data_memory_size - 4) && !device){
+				cerr << "error: the reference accesses address 0x" << hex << address << dec << " outside the data memory" << endl;
+				exit(-1);
+			}
+			if (instr.opcode == LW){
+				expected = address;
+				found = sp_registers[ALU_OUTPUT][WB];
+				if (expected != found){
+					what = "the loaded address";
+					break;
+				}
+				found = sp_registers[LMD][WB];
+				expected = device ? found : load_word(&check->data_memory[address]);
+				r[instr.dest] = expected;
+				if (expected != found) what = "the loaded value";
+			} else {
+				if (!device) memcpy(&check->data_memory[address], &r[instr.src2], 4);
+				if (check->store_address != address){
+					what = "the stored address";
+					expected = address;
+					found = check->store_address;
+				} else if (check->store_value != (unsigned) r[instr.src2]){
+					what = "the stored value";
+					expected = r[instr.src2];
+					found = check->store_value;
+				}
+			}
+			break;
+		}
+		case EOP:
+			check->finished = 1;
+			break;
+		default:
+			// branches: the target of the reference is checked by the next retired instruction
+			if (taken_branch(instr.opcode, (instr.opcode == JUMP) ? 0 : r[instr.src1])) check->pc = alu(instr.opcode, 0, 0, instr.immediate, pc+4);
+			break;
+	}
+	if (what != NULL){
+		check_report(clock_cycles, pc, instr, what, expected, found);
+		check->divergence_cycle = clock_cycles;
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,38 @@
+#ifndef SIM_CHECK_H_
+#define SIM_CHECK_H_
+
+#include "sim_pipe.h"
+
+using namespace std;
+
+/*
+State of the lockstep differential check of run() (sim_pipe::set_lockstep_check).
+
+A functional reference model (architectural registers, data memory and PC only, one instruction per step)
+is started from the state of the simulator at the first clock cycle of run(). Every time an instruction
+reaches the WB stage the reference executes its next instruction, and the architectural effects are compared:
+- the instruction itself (a wrong-path or lost instruction shows up here);
+- the value written to the destination register by ALU instructions and LW;
+- address and data of the SW, as recorded when the store leaves the MEM stage (before the store buffer).
+The first divergence is reported on cerr with its clock cycle and instruction, and stops the simulation.
+Each check is a handful of comparisons, so the check can be left enabled in long regression runs.
+Loads from devices (see mmio_device.h) take the value returned by the device, and stores to devices are checked
+but not applied to the reference memory; devices writing the data memory (DMA) are not modelled.
+*/
+
+typedef struct check_state{
+	int started; //the reference has been initialized (at the first clock cycle of run())
+	int finished; //the reference has executed the EOP
+	unsigned pc; //next instruction of the reference
+	int gp_registers[NUM_GP_REGISTERS];
+	unsigned char *data_memory;
+
+	//effect of the SW that left the MEM stage last
+	unsigned store_address;
+	unsigned store_value;
+
+	unsigned checked; //instructions checked
+	unsigned divergence_cycle; //UNDEFINED if none
+} check_state_t;
+
+#endif /*SIM_CHECK_H_*/
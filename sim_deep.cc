@@ -0,0 +1,157 @@
+#include "sim_deep.h"
+#include "prefetcher.h"
+#include <stdlib.h>
+#include <iostream>
+
+using namespace std;
+
+/* =============================================================
+
+   PIPELINE OF CONFIGURABLE DEPTH
+
+   ============================================================= */
+
+static void deep_bubble(deep_latch_t *l){
+	l->instr.opcode = NOP;
+	l->instr.src1 = UNDEFINED;
+	l->instr.src2 = UNDEFINED;
+	l->instr.dest = UNDEFINED;
+	l->instr.immediate = UNDEFINED;
+	l->pc = UNDEFINED;
+	l->a = UNDEFINED;
+	l->b = UNDEFINED;
+	l->alu_output = UNDEFINED;
+	l->lmd = UNDEFINED;
+}
+
+/* (re)allocates the latches for the given depth; a zero depth releases them */
+void sim_pipe::set_pipeline_depth(unsigned fetch_stages, unsigned execute_stages, unsigned memory_stages){
+	if (deep != NULL){
+		delete [] deep->latch;
+		delete deep;
+		deep = NULL;
+	}
+	if (fetch_stages == 0 && execute_stages == 0 && memory_stages == 0) return;
+	if (fetch_stages == 0 || execute_stages == 0 || memory_stages == 0){
+		cerr << "error: the pipeline needs at least one fetch, execute and memory stage" << endl;
+		exit(-1);
+	}
+	deep = new deep_state_t;
+	deep->fetch_stages = fetch_stages;
+	deep->execute_stages = execute_stages;
+	deep->memory_stages = memory_stages;
+	deep->num_latches = fetch_stages + execute_stages + memory_stages + 1;
+	deep->latch = new deep_latch_t[deep->num_latches];
+	deep_reset();
+}
+
+/* empties the pipeline */
+void sim_pipe::deep_reset(){
+	for (unsigned k=0; k<deep->num_latches; k++) deep_bubble(&deep->latch[k]);
+	deep->fetch_pc = UNDEFINED;
+	deep->mem_wait = 0;
+	deep->started = 0;
+}
+
+unsigned sim_pipe::get_pipeline_depth(){return (deep != NULL) ? deep->num_latches + 1 : NUM_STAGES;}
+
+unsigned sim_pipe::get_branch_penalty(){return (deep != NULL) ? deep->fetch_stages + deep->execute_stages : 2;}
+
+/* runs the pipeline; stages are processed from write back to fetch so that each one sees the latches of the previous cycle */
+void sim_pipe::run_deep(unsigned cycles){
+
+	if (num_mshrs > 0 || store_buffer_size > 0){
+		cerr << "error: run_deep models a blocking memory stage without store buffer" << endl;
+		exit(-1);
+	}
+	if (deep == NULL) set_pipeline_depth(1, 1, 1);
+
+	deep_latch_t *l = deep->latch;
+	unsigned decode = deep->fetch_stages; //index of the decode stage
+	unsigned last_execute = decode + deep->execute_stages;
+	unsigned last = deep->num_latches - 1; //input of the write back stage
+	unsigned mem_in = last - 1; //input of the last memory stage
+
+	unsigned start_cycles = clock_cycles;
+	if (!deep->started){
+		deep->fetch_pc = start_pc();
+		deep->started = 1;
+	}
+
+	while(cycles==0 || clock_cycles-start_cycles!=cycles){
+
+		/* ============   WB stage   ============  */
+		opcode_t opcode = l[last].instr.opcode;
+		if (opcode == EOP) break;
+		if (is_int_r(opcode) || is_int_imm(opcode)) set_gp_register(l[last].instr.dest, l[last].alu_output);
+		if (opcode == LW) set_gp_register(l[last].instr.dest, l[last].lmd);
+		if (opcode != NOP) instructions_executed++;
+
+		/* ============   last memory stage   ============  */
+		if (deep->mem_wait > 0){
+			// the pipeline is frozen while the access waits for the data memory
+			deep->mem_wait--;
+			deep_bubble(&l[last]);
+			stalls++;
+			clock_cycles++;
+			continue;
+		}
+		if (l[mem_in].instr.opcode == SW) write_memory(l[mem_in].alu_output, l[mem_in].b);
+		if (l[mem_in].instr.opcode == LW) l[mem_in].lmd = load_word(&data_memory[l[mem_in].alu_output]);
+		l[last] = l[mem_in];
+
+		/* ============   execute and memory stages   ============  */
+		for (unsigned k=mem_in; k>decode; k--){
+			l[k] = l[k-1];
+			opcode = l[k].instr.opcode;
+			if (k == last_execute && opcode != NOP && opcode != EOP){
+				l[k].alu_output = alu(opcode, l[k].a, l[k].b, l[k].instr.immediate, l[k].pc+4);
+				if (is_branch(opcode))
+					deep->fetch_pc = taken_branch(opcode, l[k].a) ? l[k].alu_output : l[k].pc+4;
+			}
+			if (k == mem_in && is_memory(opcode)){
+				// the access enters the last memory stage in the next cycle
+				deep->mem_wait = demand_latency(opcode, l[k].alu_output, clock_cycles+1);
+				if (data_prefetcher != NULL) prefetch_train(l[k].pc, l[k].alu_output, opcode==SW, clock_cycles+1);
+			}
+		}
+
+		/* ============   decode stage   ============  */
+		// one stall for each instruction in flight writing a source register
+		instruction_t instr = l[decode-1].instr;
+		unsigned hazards = 0;
+		for (unsigned k=decode+1; k<=last; k++)
+			if (writes_register(l[k].instr, l[k].instr.dest) && reads_register(instr, l[k].instr.dest)) hazards++;
+		if (hazards > 0){
+			deep_bubble(&l[decode]);
+			stalls += hazards;
+			clock_cycles++;
+			continue;
+		}
+		l[decode] = l[decode-1];
+		if (reads_register(instr, instr.src1) && instr.opcode != JUMP) l[decode].a = get_gp_register(instr.src1);
+		if (is_int_r(instr.opcode) || instr.opcode == SW) l[decode].b = get_gp_register(instr.src2);
+
+		/* ============   fetch stages   ============  */
+		for (unsigned k=decode-1; k>0; k--) l[k] = l[k-1];
+		int branch_pending = 0;
+		for (unsigned k=1; k<=last_execute; k++)
+			if (is_branch(l[k].instr.opcode)) branch_pending = 1;
+		if (branch_pending){
+			deep_bubble(&l[0]);
+			stalls++;
+		} else {
+			unsigned index = (deep->fetch_pc - instr_base_address)/4;
+			if (deep->fetch_pc < instr_base_address || index >= PROGRAM_SIZE){
+				cerr << "error: fetch from address 0x" << hex << deep->fetch_pc << dec << " outside the program" << endl;
+				exit(-1);
+			}
+			deep_bubble(&l[0]);
+			l[0].instr = instr_memory[index];
+			l[0].pc = deep->fetch_pc;
+			if (l[0].instr.opcode != EOP) deep->fetch_pc += 4;
+		}
+
+		clock_cycles++;
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef SIM_DEEP_H_
+#define SIM_DEEP_H_
+
+#include "sim_pipe.h"
+
+/*
+State of the pipeline of configurable depth (sim_pipe::run_deep).
+
+The pipeline has "fetch_stages" fetch stages, one decode stage (register read), "execute_stages" execute
+stages, "memory_stages" memory stages and one write back stage; latch[k] holds the output of stage k (a NOP
+is a bubble). As in run(), there is no forwarding: an instruction leaves the decode stage only when none of
+the instructions between it and the write back stage writes one of its sources, and fetch stops from the
+fetch of a branch until the branch leaves the last execute stage (branch penalty: fetch_stages+execute_stages).
+A memory access waiting for the data memory freezes the pipeline in front of the last memory stage.
+With one stage of each kind the pipeline is the 5-stage pipeline of run(), with the same timing.
+*/
+
+/* content of a pipeline latch */
+typedef struct{
+	instruction_t instr; //NOP = bubble
+	unsigned pc; //address of the instruction
+	unsigned a, b; //source operands read in the decode stage
+	unsigned alu_output;
+	unsigned lmd; //word read by a LW
+} deep_latch_t;
+
+typedef struct deep_state{
+	//configuration
+	unsigned fetch_stages;
+	unsigned execute_stages;
+	unsigned memory_stages;
+
+	deep_latch_t *latch; //fetch_stages+execute_stages+memory_stages+1 latches
+	unsigned num_latches;
+
+	unsigned fetch_pc;
+	unsigned mem_wait; //clock cycles the access in front of the last memory stage still waits for the data memory
+	int started; //fetch_pc initialized
+} deep_state_t;
+
+#endif /*SIM_DEEP_H_*/
@@ -0,0 +1,145 @@
+#include "sim_energy.h"
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+using namespace std;
+
+/* =============================================================
+
+   ENERGY MODEL
+
+   ============================================================= */
+
+static const char *energy_event_names[NUM_ENERGY_EVENTS] = {"RF reads", "RF writes", "ALU operations", "memory reads", "memory writes", "latch updates", "stall cycles"};
+
+void energy_table_default(energy_table_t *table){
+	table->event[RF_READ] = 1.2;
+	table->event[RF_WRITE] = 1.6;
+	table->event[ALU_OP] = 2.5;
+	table->event[MEM_READ] = 12.0;
+	table->event[MEM_WRITE] = 14.0;
+	table->event[LATCH_UPDATE] = 0.4;
+	table->event[STALL_CYCLE] = 0.8; //clock tree and bubble latching
+	table->leakage = 3.0;
+	table->clock_ghz = 1.0;
+}
+
+void sim_pipe::set_energy_model(const energy_table_t *table, unsigned interval_cycles){
+	delete energy;
+	energy = NULL;
+	if (table == NULL) return;
+	energy = new energy_state_t;
+	energy->table = *table;
+	energy->interval_cycles = interval_cycles;
+	energy_reset();
+}
+
+void sim_pipe::energy_reset(){
+	for (unsigned e=0; e<NUM_ENERGY_EVENTS; e++) energy->events[e] = 0;
+	energy->intervals.clear();
+	energy_snapshot(&energy->current);
+}
+
+/* copies the counters since the beginning of the simulation into "snapshot" */
+void sim_pipe::energy_snapshot(energy_interval_t *snapshot){
+	snapshot->start_cycle = clock_cycles;
+	snapshot->cycles = 0;
+	snapshot->instructions = instructions_executed;
+	for (unsigned e=0; e<NUM_ENERGY_EVENTS; e++) snapshot->events[e] = energy->events[e];
+	snapshot->events[STALL_CYCLE] = stalls;
+}
+
+/* activity of the open interval: counters now minus counters at its beginning */
+void sim_pipe::energy_open_interval(energy_interval_t *interval){
+	energy_interval_t now;
+	energy_snapshot(&now);
+	*interval = energy->current;
+	interval->cycles = now.start_cycle - energy->current.start_cycle;
+	interval->instructions = now.instructions - energy->current.instructions;
+	for (unsigned e=0; e<NUM_ENERGY_EVENTS; e++) interval->events[e] = now.events[e] - energy->current.events[e];
+}
+
+/* counts the activity of the instruction written back in this cycle (called before the WB stage) */
+void sim_pipe::energy_commit(){
+	if (energy->interval_cycles > 0 && clock_cycles - energy->current.start_cycle >= energy->interval_cycles){
+		energy_interval_t closed;
+		energy_open_interval(&closed);
+		energy->intervals.push_back(closed);
+		energy_snapshot(&energy->current);
+	}
+
+	// the EOP stays in the MEM/WB latch once the program has ended (and run() may be called again): it is not counted
+	opcode_t opcode = ir[MEM].opcode;
+	if (opcode == NOP || opcode == EOP) return;
+	unsigned long long *events = energy->events;
+	events[LATCH_UPDATE] += 4;
+	events[ALU_OP]++;
+	if (is_int_r(opcode) || opcode == SW) events[RF_READ] += 2;
+	else if (opcode != JUMP) events[RF_READ]++;
+	if (is_int_r(opcode) || is_int_imm(opcode) || opcode == LW) events[RF_WRITE]++;
+	if (opcode == LW) events[MEM_READ]++;
+	if (opcode == SW) events[MEM_WRITE]++;
+}
+
+static double interval_dynamic_energy(const energy_table_t *table, const energy_interval_t *interval){
+	double energy = 0;
+	for (unsigned e=0; e<NUM_ENERGY_EVENTS; e++) energy += interval->events[e] * table->event[e];
+	return energy;
+}
+
+float sim_pipe::get_energy(){
+	if (energy == NULL) return 0;
+	energy_interval_t all;
+	energy_snapshot(&all);
+	return interval_dynamic_energy(&energy->table, &all) + energy->table.leakage * clock_cycles;
+}
+
+float sim_pipe::get_average_power(){
+	if (energy == NULL || clock_cycles == 0) return 0;
+	return get_energy() * energy->table.clock_ghz / clock_cycles;
+}
+
+float sim_pipe::get_energy_per_instruction(){
+	if (energy == NULL || instructions_executed == 0) return 0;
+	return get_energy() / instructions_executed;
+}
+
+void sim_pipe::print_energy_stats(){
+	if (energy == NULL) return;
+	ios::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
+	const energy_table_t *table = &energy->table;
+	energy_interval_t all;
+	energy_snapshot(&all);
+	double dynamic = interval_dynamic_energy(table, &all);
+	double leakage = table->leakage * clock_cycles;
+	cout << fixed << setprecision(1);
+	for (unsigned e=0; e<NUM_ENERGY_EVENTS; e++)
+		cout << setw(16) << energy_event_names[e] << ": " << setw(12) << all.events[e] << " x " << setw(6) << table->event[e] << " pJ = " << setw(14) << all.events[e] * table->event[e] << " pJ" << endl;
+	cout << "Dynamic energy: " << dynamic << " pJ" << endl;
+	cout << "Leakage energy: " << leakage << " pJ (" << clock_cycles << " cycles x " << table->leakage << " pJ)" << endl;
+	cout << "Total energy: " << dynamic + leakage << " pJ" << endl;
+	cout << setprecision(3);
+	cout << "IPC: " << get_IPC() << endl;
+	cout << "Average power: " << get_average_power() << " mW at " << table->clock_ghz << " GHz" << endl;
+	cout << "Energy per instruction: " << get_energy_per_instruction() << " pJ" << endl;
+	if (energy->interval_cycles > 0){
+		vector<energy_interval_t> intervals = energy->intervals;
+		energy_interval_t open;
+		energy_open_interval(&open);
+		if (open.cycles > 0) intervals.push_back(open);
+		cout << "     cycle     cycles       IPC   dynamic (pJ)   leakage (pJ)   power (mW)   EPI (pJ)" << endl;
+		for (unsigned i=0; i<intervals.size(); i++){
+			energy_interval_t *in = &intervals[i];
+			double d = interval_dynamic_energy(table, in);
+			double l = table->leakage * in->cycles;
+			cout << setw(10) << in->start_cycle << " " << setw(10) << in->cycles << " " << setw(9) << (in->cycles ? (double) in->instructions / in->cycles : 0)
+			     << " " << setw(14) << d << " " << setw(14) << l << " " << setw(12) << (in->cycles ? (d + l) * table->clock_ghz / in->cycles : 0)
+			     << " " << setw(10) << (in->instructions ? (d + l) / in->instructions : 0) << endl;
+		}
+	}
+	cout.flags(flags);
+	cout.precision(precision);
+}
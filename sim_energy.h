@@ -0,0 +1,57 @@
+#ifndef SIM_ENERGY_H_
+#define SIM_ENERGY_H_
+
+#include "sim_pipe.h"
+#include <vector>
+
+using namespace std;
+
+/*
+Activity-based energy model of run() (sim_pipe::set_energy_model).
+
+Every instruction written back has gone through each stage once (the pipeline does not fetch past a branch
+before resolving it), so the activity is counted when the instruction reaches the WB stage:
+- register file reads in ID: the source registers of the instruction;
+- register file writes in WB: ALU instructions and LW;
+- ALU operations in EXE: every instruction (arithmetic, effective address, branch condition and target);
+- data memory reads and writes in MEM: LW and SW;
+- latch updates: the four pipeline latches the instruction is written to (IF/ID, ID/EX, EX/MEM, MEM/WB).
+The EOP, which only ends the simulation, has no activity. Stall cycles (bubbles) are the stalls of run().
+Dynamic energy is the sum over the events of their count times their energy in the table; leakage energy is the
+leakage per clock cycle times the clock cycles. Energies are in picojoules: at a clock of f GHz, a cycle is 1/f ns
+and pJ/ns are mW.
+
+The steady-state loop acceleration is disabled while the model is enabled (its iterations skip the WB stage).
+*/
+
+typedef enum {RF_READ, RF_WRITE, ALU_OP, MEM_READ, MEM_WRITE, LATCH_UPDATE, STALL_CYCLE, NUM_ENERGY_EVENTS} energy_event_t;
+
+/* energy per event (pJ), leakage per clock cycle (pJ) and clock frequency (GHz) */
+typedef struct energy_table{
+	double event[NUM_ENERGY_EVENTS];
+	double leakage;
+	double clock_ghz;
+} energy_table_t;
+
+/* fills "table" with the default energies: a simple in-order core, 45 nm, 1 GHz */
+void energy_table_default(energy_table_t *table);
+
+/* activity of an interval of clock cycles */
+typedef struct energy_interval{
+	unsigned start_cycle;
+	unsigned cycles;
+	unsigned instructions;
+	unsigned long long events[NUM_ENERGY_EVENTS];
+} energy_interval_t;
+
+typedef struct energy_state{
+	//configuration
+	energy_table_t table;
+	unsigned interval_cycles; //0 = no breakdown
+
+	unsigned long long events[NUM_ENERGY_EVENTS]; //since the beginning of the simulation (stall cycles excluded: see stalls)
+	vector<energy_interval_t> intervals; //closed intervals
+	energy_interval_t current; //start of the open interval (counters at its first cycle)
+} energy_state_t;
+
+#endif /*SIM_ENERGY_H_*/
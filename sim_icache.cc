@@ -0,0 +1,110 @@
+#include "sim_icache.h"
+#include <stdlib.h>
+#include <iostream>
+
+using namespace std;
+
+/* =============================================================
+
+   INSTRUCTION CACHE
+
+   ============================================================= */
+
+void sim_pipe::set_icache(unsigned size, unsigned line_size, unsigned assoc, unsigned miss_latency, unsigned buffer_lines){
+	if (icache != NULL){
+		delete [] icache->lines;
+		delete [] icache->buffer;
+		delete icache;
+		icache = NULL;
+	}
+	if (size == 0) return;
+	if (line_size == 0 || line_size % 4 != 0 || assoc == 0 || size % (line_size * assoc) != 0){
+		cerr << "error: the instruction cache size must be a multiple of line size (multiple of 4 bytes) times associativity" << endl;
+		exit(-1);
+	}
+	icache = new icache_state_t;
+	icache->size = size;
+	icache->line_size = line_size;
+	icache->assoc = assoc;
+	icache->sets = size / (line_size * assoc);
+	icache->miss_latency = miss_latency;
+	icache->buffer_lines = buffer_lines;
+	icache->lines = new icache_line_t[size / line_size];
+	icache->buffer = new fetch_buffer_entry_t[buffer_lines];
+	icache_reset();
+}
+
+/* invalidates cache and fetch buffer */
+void sim_pipe::icache_reset(){
+	for (unsigned i=0; i<icache->sets * icache->assoc; i++) icache->lines[i].line = UNDEFINED;
+	for (unsigned i=0; i<icache->buffer_lines; i++) icache->buffer[i].line = UNDEFINED;
+	icache->fill_line = UNDEFINED;
+	icache->misses = 0;
+	icache->buffer_hits = 0;
+	icache->fetch_stalls = 0;
+}
+
+unsigned sim_pipe::get_icache_misses(){return (icache != NULL) ? icache->misses : 0;}
+
+unsigned sim_pipe::get_fetch_buffer_hits(){return (icache != NULL) ? icache->buffer_hits : 0;}
+
+unsigned sim_pipe::get_fetch_stalls(){return (icache != NULL) ? icache->fetch_stalls : 0;}
+
+/* returns 1 if the instruction at "pc" cannot be fetched in this clock cycle; starts the fill of its line on a miss */
+int sim_pipe::icache_wait(unsigned pc){
+	unsigned line = pc - pc % icache->line_size;
+	icache_line_t *set = &icache->lines[(line / icache->line_size) % icache->sets * icache->assoc];
+
+	for (unsigned w=0; w<icache->assoc; w++){
+		if (set[w].line == line){
+			set[w].last_use = clock_cycles;
+			return 0;
+		}
+	}
+
+	if (icache->fill_line != line){
+		icache->fill_line = line;
+		icache->fill_ready = UNDEFINED;
+		for (unsigned i=0; i<icache->buffer_lines; i++){
+			if (icache->buffer[i].line != line) continue;
+			icache->fill_ready = icache->buffer[i].ready_cycle;
+			icache->buffer[i].line = UNDEFINED;
+			icache->buffer_hits++;
+		}
+		if (icache->fill_ready == UNDEFINED){
+			// miss: the fetch buffer streams the following lines
+			icache->misses++;
+			icache->fill_ready = clock_cycles + icache->miss_latency;
+			for (unsigned i=0; i<icache->buffer_lines; i++){
+				icache->buffer[i].line = line + (i+1) * icache->line_size;
+				icache->buffer[i].ready_cycle = icache->fill_ready + i + 1;
+			}
+		}
+	}
+	if (clock_cycles < icache->fill_ready) return 1;
+
+	// the line has arrived: replace the least recently used way
+	unsigned victim = 0;
+	for (unsigned w=0; w<icache->assoc; w++){
+		if (set[w].line == UNDEFINED){
+			victim = w;
+			break;
+		}
+		if (set[w].last_use < set[victim].last_use) victim = w;
+	}
+	set[victim].line = line;
+	set[victim].last_use = clock_cycles;
+	icache->fill_line = UNDEFINED;
+	return 0;
+}
+
+/* bubble inserted in IF/ID while the IF stage waits for the instruction cache (propagated as a control hazard bubble) */
+void sim_pipe::icache_bubble(){
+	ir[IF].opcode=NOP;
+	ir[IF].src1=UNDEFINED;
+	ir[IF].src2=UNDEFINED;
+	ir[IF].dest=UNDEFINED;
+	ir[IF].immediate=UNDEFINED;
+	sp_registers[NPC][ID]=UNDEFINED;
+	control_hazard_propagate=1;
+}
@@ -0,0 +1,48 @@
+#ifndef SIM_ICACHE_H_
+#define SIM_ICACHE_H_
+
+#include "sim_pipe.h"
+
+/*
+State of the instruction cache of the IF stage (sim_pipe::set_icache).
+
+Set-associative cache with LRU replacement, indexed by the PC. A fetch that misses starts the fill of the
+line and the IF stage inserts a bubble in every clock cycle until the line arrives, "miss_latency" cycles later.
+On a miss, the fetch buffer (a stream buffer) requests the following sequential lines, arriving one per clock
+cycle after the missing one; a fetch that misses in the cache but finds its line in the fetch buffer moves it
+to the cache and only waits for it to arrive.
+*/
+
+/* cache line */
+typedef struct{
+	unsigned line; //line address (UNDEFINED if invalid)
+	unsigned last_use; //clock cycle of the last fetch (LRU replacement)
+} icache_line_t;
+
+/* fetch buffer entry */
+typedef struct{
+	unsigned line; //line address (UNDEFINED if free)
+	unsigned ready_cycle; //clock cycle in which the line arrives
+} fetch_buffer_entry_t;
+
+typedef struct icache_state{
+	//configuration
+	unsigned size; //bytes
+	unsigned line_size; //bytes
+	unsigned assoc;
+	unsigned sets;
+	unsigned miss_latency; //clock cycles
+	unsigned buffer_lines; //0 = no fetch buffer
+
+	icache_line_t *lines; //sets*assoc entries, set-major
+	fetch_buffer_entry_t *buffer;
+	unsigned fill_line; //line being filled (UNDEFINED if none)
+	unsigned fill_ready; //clock cycle in which it arrives
+
+	//statistics
+	unsigned misses;
+	unsigned buffer_hits;
+	unsigned fetch_stalls; //bubbles inserted by the IF stage waiting for a line
+} icache_state_t;
+
+#endif /*SIM_ICACHE_H_*/
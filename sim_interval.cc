@@ -0,0 +1,236 @@
+#include "sim_interval.h"
+#include "sim_xlat.h"
+#include "sim_icache.h"
+#include "mem_backend.h"
+#include "prefetcher.h"
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+/* =============================================================
+
+   PARALLEL INTERVAL SIMULATION
+
+   ============================================================= */
+
+/* architectural state "warmup" instructions before the start of an interval */
+typedef struct{
+	unsigned long long position; //instructions executed before the checkpoint
+	unsigned long long start; //first instruction of the interval
+	unsigned pc;
+	int gp_registers[NUM_GP_REGISTERS];
+	vector<unsigned char> data_memory;
+} checkpoint_t;
+
+static double seconds_since(chrono::steady_clock::time_point start){
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/* returns a new simulator with the program, the architectural state and the configuration of this one (memory models cloned) */
+sim_pipe *sim_pipe::interval_simulator(){
+	sim_pipe *sim = new sim_pipe(data_memory_size, data_memory_latency);
+	for (unsigned i=0; i<PROGRAM_SIZE; i++) sim->instr_memory[i] = instr_memory[i];
+	sim->instr_base_address = instr_base_address;
+	memcpy(sim->gp_registers, gp_registers, sizeof(gp_registers));
+	if (data_memory_size > 0) memcpy(sim->data_memory, data_memory, data_memory_size);
+	sim->xlat_start(start_pc());
+	if (num_mshrs > 0) sim->set_mshrs(num_mshrs);
+	if (store_buffer_size > 0) sim->set_store_buffer(store_buffer_size);
+	if (backend != default_backend) sim->set_mem_backend(backend->clone());
+	if (data_prefetcher != NULL) sim->set_prefetcher(data_prefetcher->clone(), prefetch_buffer_size);
+	if (icache != NULL) sim->set_icache(icache->size, icache->line_size, icache->assoc, icache->miss_latency, icache->buffer_lines);
+	return sim;
+}
+
+/* deletes a simulator returned by interval_simulator, with its cloned memory models */
+void sim_pipe::release_simulator(sim_pipe *sim){
+	mem_backend *b = (sim->backend != sim->default_backend) ? sim->backend : NULL;
+	prefetcher *p = sim->data_prefetcher;
+	delete sim;
+	delete b;
+	delete p;
+}
+
+/* executes "instructions" instructions (at least) with translated blocks; returns false once the program has reached its EOP */
+static bool functional_advance(sim_pipe *f, unsigned long long instructions, unsigned long long *position){
+	f->run_translated(instructions);
+	unsigned long long executed = f->get_translated_instructions() - *position;
+	*position = f->get_translated_instructions();
+	return executed >= instructions;
+}
+
+void sim_pipe::run_intervals(unsigned interval, unsigned warmup, unsigned threads, bool compare){
+	if (clock_cycles != 0){
+		cerr << "error: run_intervals() can only run before the first clock cycle" << endl;
+		exit(-1);
+	}
+	if (interval == 0 || warmup >= interval){
+		cerr << "error: the warm-up must be shorter than the interval" << endl;
+		exit(-1);
+	}
+	if (mmio != NULL){
+		cerr << "error: run_intervals() does not support memory-mapped devices" << endl;
+		exit(-1);
+	}
+	if (threads == 0) threads = thread::hardware_concurrency();
+	if (threads == 0) threads = 1;
+	delete intervals;
+	intervals = new interval_state_t;
+	intervals->threads = threads;
+	intervals->serial_cycles = UNDEFINED;
+	intervals->serial_stalls = UNDEFINED;
+	intervals->serial_seconds = 0;
+
+	// functional pass: checkpoints at the beginning of the warm-up of each interval
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	sim_pipe *f = interval_simulator();
+	vector<checkpoint_t> checkpoints(1);
+	checkpoints[0].position = 0;
+	checkpoints[0].start = 0;
+	checkpoints[0].pc = f->start_pc();
+	unsigned long long position = 0;
+	for (unsigned long long k=1; ; k++){
+		unsigned long long boundary = k * interval;
+		// the checkpoint is the last block boundary at least "warmup" instructions before the interval: blocks
+		// are executed whole, so the pass runs up to one block length short of it, then one block at a time
+		unsigned long long target = boundary - warmup;
+		if (target > position + XLAT_MAX_BLOCK && !functional_advance(f, target - XLAT_MAX_BLOCK - position, &position)) break;
+		bool running = true;
+		while (running){
+			xlat_block_t *block = f->xlat_translate(f->start_pc());
+			if (block == NULL || position + block->ops.size() > target) break;
+			running = functional_advance(f, 1, &position);
+		}
+		if (!running) break;
+		// a block overlapping the whole warm-up and interval: the interval is merged with the previous one
+		if (position >= boundary) continue;
+		checkpoint_t c;
+		c.position = position;
+		c.pc = f->start_pc();
+		memcpy(c.gp_registers, f->gp_registers, sizeof(c.gp_registers));
+		c.data_memory.assign(f->data_memory, f->data_memory + data_memory_size);
+		if (boundary > position && !functional_advance(f, boundary - position, &position)) break;
+		c.start = position;
+		checkpoints.push_back(c);
+	}
+	// the functional pass stops at the EOP, or in front of an instruction it cannot execute
+	unsigned index = (f->start_pc() - instr_base_address)/4;
+	if (f->start_pc() < instr_base_address || index >= PROGRAM_SIZE || instr_memory[index].opcode != EOP){
+		cerr << "error: the functional execution stopped at 0x" << hex << f->start_pc() << dec << " before the EOP (access outside the data memory)" << endl;
+		exit(-1);
+	}
+	release_simulator(f);
+	intervals->functional_seconds = seconds_since(start);
+
+	// detailed simulation of the intervals (and of the whole program, if requested) by a pool of threads
+	unsigned n = checkpoints.size();
+	intervals->intervals.resize(n);
+	unsigned tasks = n + (compare ? 1 : 0);
+	atomic<unsigned> next(0);
+	int final_registers[NUM_GP_REGISTERS];
+	vector<unsigned char> final_memory(data_memory_size);
+	start = chrono::steady_clock::now();
+	vector<thread> pool;
+	for (unsigned t=0; t<threads && t<tasks; t++)
+		pool.push_back(thread([this, &checkpoints, &next, n, tasks, &final_registers, &final_memory](){
+			unsigned task;
+			while ((task = next++) < tasks){
+				chrono::steady_clock::time_point task_start = chrono::steady_clock::now();
+				sim_pipe *sim = interval_simulator();
+				if (task == n){
+					sim->run();
+					intervals->serial_cycles = sim->clock_cycles;
+					intervals->serial_stalls = sim->stalls;
+					intervals->serial_seconds = seconds_since(task_start);
+					release_simulator(sim);
+					continue;
+				}
+				checkpoint_t *c = &checkpoints[task];
+				if (task > 0){
+					// the first interval starts from the initial state, copied by interval_simulator
+					memcpy(sim->gp_registers, c->gp_registers, sizeof(c->gp_registers));
+					if (data_memory_size > 0) memcpy(sim->data_memory, &c->data_memory[0], data_memory_size);
+					sim->xlat_start(c->pc);
+				}
+				unsigned warm = c->start - c->position;
+				bool last = (task == n-1);
+				unsigned end = last ? UNDEFINED : checkpoints[task+1].start - c->position;
+				unsigned mark_cycles = UNDEFINED, mark_stalls = 0;
+				while (1){
+					if (mark_cycles == UNDEFINED && sim->instructions_executed >= warm){
+						mark_cycles = sim->clock_cycles;
+						mark_stalls = sim->stalls;
+						if (last){
+							sim->run();
+							break;
+						}
+					}
+					if (sim->instructions_executed >= end) break;
+					unsigned before = sim->clock_cycles;
+					sim->run(1);
+					if (sim->clock_cycles == before) break; //EOP written back
+				}
+				interval_t *i = &intervals->intervals[task];
+				i->start = c->start;
+				i->warmup = warm;
+				i->instructions = sim->instructions_executed - warm;
+				i->cycles = sim->clock_cycles - mark_cycles;
+				i->stalls = sim->stalls - mark_stalls;
+				i->seconds = seconds_since(task_start);
+				if (last){
+					// the other workers still copy the initial state of this simulator
+					memcpy(final_registers, sim->gp_registers, sizeof(final_registers));
+					if (data_memory_size > 0) memcpy(&final_memory[0], sim->data_memory, data_memory_size);
+				}
+				release_simulator(sim);
+			}
+		}));
+	for (unsigned t=0; t<pool.size(); t++) pool[t].join();
+	intervals->parallel_seconds = seconds_since(start);
+	memcpy(gp_registers, final_registers, sizeof(gp_registers));
+	if (data_memory_size > 0) memcpy(data_memory, &final_memory[0], data_memory_size);
+
+	// stitching
+	clock_cycles = 0;
+	stalls = 0;
+	instructions_executed = 0;
+	for (unsigned k=0; k<n; k++){
+		clock_cycles += intervals->intervals[k].cycles;
+		stalls += intervals->intervals[k].stalls;
+		instructions_executed += intervals->intervals[k].instructions;
+	}
+}
+
+float sim_pipe::get_interval_cycle_error(){
+	if (intervals == NULL || intervals->serial_cycles == UNDEFINED || intervals->serial_cycles == 0) return 0;
+	return ((float) clock_cycles - intervals->serial_cycles) / intervals->serial_cycles;
+}
+
+void sim_pipe::print_interval_stats(){
+	if (intervals == NULL) return;
+	ios::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
+	cout << "intervals: " << intervals->intervals.size() << " on " << intervals->threads << " threads" << endl;
+	cout << "     start    warm-up   instructions       cycles       stalls    seconds" << endl;
+	for (unsigned k=0; k<intervals->intervals.size(); k++){
+		interval_t *i = &intervals->intervals[k];
+		cout << dec << setw(10) << i->start << " " << setw(10) << i->warmup << " " << setw(14) << i->instructions << " " << setw(12) << i->cycles
+		     << " " << setw(12) << i->stalls << " " << fixed << setprecision(3) << setw(10) << i->seconds << endl;
+	}
+	cout << "stitched: cycles " << clock_cycles << " stalls " << stalls << " instructions " << instructions_executed << endl;
+	cout << "wall-clock: functional pass " << fixed << setprecision(3) << intervals->functional_seconds << " s, intervals "
+	     << intervals->parallel_seconds << " s" << endl;
+	if (intervals->serial_cycles != UNDEFINED){
+		cout << "serial: cycles " << intervals->serial_cycles << " stalls " << intervals->serial_stalls << " (" << intervals->serial_seconds << " s)" << endl;
+		cout << "error: cycles " << showpos << setprecision(3) << 100.0 * get_interval_cycle_error() << "%, stalls "
+		     << (intervals->serial_stalls == 0 ? 0.0 : 100.0 * ((double) stalls - intervals->serial_stalls) / intervals->serial_stalls) << "%" << endl;
+	}
+	cout.flags(flags);
+	cout.precision(precision);
+}
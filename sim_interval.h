@@ -0,0 +1,43 @@
+#ifndef SIM_INTERVAL_H_
+#define SIM_INTERVAL_H_
+
+#include "sim_pipe.h"
+#include <vector>
+
+using namespace std;
+
+/*
+Results of the parallel interval simulation (sim_pipe::run_intervals).
+
+A functional pass (translated blocks, see sim_xlat.h) splits the dynamic instruction stream in intervals of about
+"interval" instructions (the boundaries fall on basic block boundaries) and takes a checkpoint of the architectural
+state (registers, data memory, PC) at the last block boundary at least "warmup" instructions before the start of
+each one. Every interval is then simulated by run() on its own simulator, in parallel: from its checkpoint, the
+warm-up instructions fill the pipeline and train the memory models (memory backend and prefetcher are cloned from
+the simulator, with their state reset), then the interval itself is measured from the write back of its first instruction to the write
+back of its last one. The statistics of the intervals are summed; the first interval starts from the initial state
+(no warm-up) and the last one runs to the EOP, so fill and drain of the pipeline are counted once.
+*/
+
+typedef struct{
+	unsigned long long start; //index of the first instruction in the dynamic instruction stream
+	unsigned warmup; //instructions simulated in detail before the interval
+	unsigned instructions;
+	unsigned cycles;
+	unsigned stalls;
+	double seconds; //wall-clock time of the detailed simulation (warm-up included)
+} interval_t;
+
+typedef struct interval_state{
+	vector<interval_t> intervals;
+	unsigned threads;
+	double functional_seconds; //checkpointing pass
+	double parallel_seconds; //detailed simulation of all the intervals
+
+	//serial simulation of the whole program (UNDEFINED if not requested)
+	unsigned serial_cycles;
+	unsigned serial_stalls;
+	double serial_seconds;
+} interval_state_t;
+
+#endif /*SIM_INTERVAL_H_*/
@@ -0,0 +1,133 @@
+#include "sim_limit.h"
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std;
+
+/* =============================================================
+
+   DATAFLOW LIMIT STUDY
+
+   ============================================================= */
+
+static const char *limit_model_names[NUM_LIMIT_MODELS] = {"dataflow", "+ memory latency", "+ control dependences"};
+
+void sim_pipe::set_limit_study(bool enable){
+	delete limit_study;
+	limit_study = NULL;
+	if (!enable) return;
+	limit_study = new limit_state_t;
+	limit_reset();
+}
+
+void sim_pipe::limit_reset(){
+	for (unsigned m=0; m<NUM_LIMIT_MODELS; m++){
+		for (unsigned r=0; r<NUM_GP_REGISTERS; r++) limit_study->registers[r].ready[m] = 0;
+		limit_study->branch.ready[m] = 0;
+		limit_study->critical_path.ready[m] = 0;
+	}
+	limit_study->memory.clear();
+	limit_study->instructions = 0;
+	limit_study->register_edges = 0;
+	limit_study->memory_edges = 0;
+	limit_study->raw_stall_cycles = 0;
+	limit_study->control_stall_cycles = 0;
+	limit_study->memory_stall_cycles = 0;
+}
+
+/* raises "start" to the time at which the source "time" is produced */
+static void limit_depend(limit_time_t *start, const limit_time_t *time){
+	for (unsigned m=0; m<NUM_LIMIT_MODELS; m++)
+		if (time->ready[m] > start->ready[m]) start->ready[m] = time->ready[m];
+}
+
+/* adds the instruction written back in this cycle to the dependence graph (called before the WB stage) */
+void sim_pipe::limit_commit(){
+	instruction_t *instr = &ir[MEM];
+	opcode_t opcode = instr->opcode;
+	if (opcode == NOP || opcode == EOP) return;
+	limit_study->instructions++;
+
+	// source registers
+	limit_time_t start = {{0}};
+	unsigned sources[2];
+	unsigned num_sources = 0;
+	if (is_int_r(opcode) || opcode == SW){
+		sources[num_sources++] = instr->src1;
+		sources[num_sources++] = instr->src2;
+	} else if (opcode != JUMP) sources[num_sources++] = instr->src1;
+	for (unsigned s=0; s<num_sources; s++){
+		limit_time_t *producer = &limit_study->registers[sources[s]];
+		if (producer->ready[LIMIT_DATAFLOW] > 0) limit_study->register_edges++;
+		limit_depend(&start, producer);
+	}
+
+	// a LW reads the words written by the last SW to its (possibly unaligned) address
+	unsigned address = sp_registers[ALU_OUTPUT][WB];
+	unsigned words[2] = {address/4, (address+3)/4};
+	if (opcode == LW){
+		int edge = 0;
+		for (unsigned w=0; w<2; w++){
+			unordered_map<unsigned, limit_time_t>::iterator it = limit_study->memory.find(words[w]);
+			if (it == limit_study->memory.end()) continue;
+			limit_depend(&start, &it->second);
+			edge = 1;
+		}
+		if (edge) limit_study->memory_edges++;
+	}
+
+	start.ready[LIMIT_CONTROL] = max(start.ready[LIMIT_CONTROL], limit_study->branch.ready[LIMIT_CONTROL]);
+
+	limit_time_t finish;
+	for (unsigned m=0; m<NUM_LIMIT_MODELS; m++){
+		finish.ready[m] = start.ready[m] + 1;
+		if (m == LIMIT_MEMORY && is_memory(opcode)) finish.ready[m] += data_memory_latency;
+	}
+	limit_depend(&limit_study->critical_path, &finish);
+
+	if (is_int_r(opcode) || is_int_imm(opcode) || opcode == LW) limit_study->registers[instr->dest] = finish;
+	if (opcode == SW){
+		limit_study->memory[words[0]] = finish;
+		limit_study->memory[words[1]] = finish;
+	}
+	if (is_branch(opcode) && opcode != JUMP) limit_study->branch = finish;
+}
+
+unsigned long long sim_pipe::get_critical_path(){return (limit_study != NULL) ? limit_study->critical_path.ready[LIMIT_DATAFLOW] : 0;}
+
+float sim_pipe::get_ideal_IPC(){
+	if (limit_study == NULL || limit_study->critical_path.ready[LIMIT_DATAFLOW] == 0) return 0;
+	return (float) limit_study->instructions / limit_study->critical_path.ready[LIMIT_DATAFLOW];
+}
+
+unsigned sim_pipe::get_raw_stall_cycles(){return (limit_study != NULL) ? limit_study->raw_stall_cycles : 0;}
+
+unsigned sim_pipe::get_control_stall_cycles(){return (limit_study != NULL) ? limit_study->control_stall_cycles : 0;}
+
+unsigned sim_pipe::get_memory_stall_cycles(){return (limit_study != NULL) ? limit_study->memory_stall_cycles : 0;}
+
+void sim_pipe::print_limit_stats(){
+	if (limit_study == NULL) return;
+	ios::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
+	cout << fixed << setprecision(3);
+	cout << "dependence graph: " << limit_study->instructions << " instructions, " << limit_study->register_edges << " register and "
+	     << limit_study->memory_edges << " memory dependences" << endl;
+	cout << "                 model  critical path  ideal IPC" << endl;
+	for (unsigned m=0; m<NUM_LIMIT_MODELS; m++){
+		unsigned long long path = limit_study->critical_path.ready[m];
+		cout << setw(22) << limit_model_names[m] << " " << setw(14) << path << " " << setw(10) << (path ? (double) limit_study->instructions / path : 0) << endl;
+	}
+	cout << "measured: cycles " << clock_cycles << " IPC " << (clock_cycles ? (double) instructions_executed / clock_cycles : 0) << endl;
+	cout << "    stall cause   cycles   IPC without" << endl;
+	const char *causes[3] = {"RAW", "control", "memory"};
+	unsigned cycles[3] = {limit_study->raw_stall_cycles, limit_study->control_stall_cycles, limit_study->memory_stall_cycles};
+	for (unsigned c=0; c<3; c++){
+		unsigned remaining = clock_cycles - cycles[c];
+		cout << setw(15) << causes[c] << " " << setw(8) << cycles[c] << " " << setw(13) << (remaining ? (double) instructions_executed / remaining : 0) << endl;
+	}
+	cout.flags(flags);
+	cout.precision(precision);
+}
@@ -0,0 +1,52 @@
+#ifndef SIM_LIMIT_H_
+#define SIM_LIMIT_H_
+
+#include "sim_pipe.h"
+#include <unordered_map>
+
+using namespace std;
+
+/*
+Dataflow limit study of run() (sim_pipe::set_limit_study).
+
+Every instruction written back is added to the dynamic dependence graph of the program: it depends on the
+producers of its source registers and, for a LW, on the last SW to the words it reads (true dependences only:
+registers and memory are ideally renamed). Only the clock cycle at which each register and memory word is
+produced is kept, so the longest path of the graph (critical path) is computed while the program runs. The
+graph is timed under three models, each adding one constraint to the pure dataflow one:
+- dataflow: every instruction completes one cycle after its last source is produced;
+- memory: LW and SW take the data memory latency on top of their cycle;
+- control: no instruction starts before the previous conditional branch has completed (no prediction).
+The ideal IPC of a model is the number of instructions over its critical path.
+
+The clock cycles in which run() stalls are also split by cause: RAW (ID stage waiting for a source register,
+scoreboard included), control (IF stage bubbles after a branch) and memory (frozen MEM stage, EOP draining).
+The IPC without a cause is the one of the measured run with those cycles removed.
+
+The steady-state loop acceleration is disabled while the study is enabled (its iterations skip the WB stage).
+*/
+
+typedef enum {LIMIT_DATAFLOW, LIMIT_MEMORY, LIMIT_CONTROL, NUM_LIMIT_MODELS} limit_model_t;
+
+/* clock cycle at which a value is produced, in each model (0: before the program starts) */
+typedef struct{
+	unsigned long long ready[NUM_LIMIT_MODELS];
+} limit_time_t;
+
+typedef struct limit_state{
+	//dependence graph
+	limit_time_t registers[NUM_GP_REGISTERS];
+	unordered_map<unsigned, limit_time_t> memory; //by word (address/4), written by the last SW
+	limit_time_t branch; //completion of the last conditional branch
+	limit_time_t critical_path;
+	unsigned long long instructions;
+	unsigned long long register_edges; //source registers produced by an earlier instruction
+	unsigned long long memory_edges; //LW reading a word written by an earlier SW
+
+	//stall cycles of run() by cause
+	unsigned raw_stall_cycles;
+	unsigned control_stall_cycles;
+	unsigned memory_stall_cycles;
+} limit_state_t;
+
+#endif /*SIM_LIMIT_H_*/
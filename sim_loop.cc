@@ -0,0 +1,220 @@
+#include "sim_loop.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+#define LOOP_HASH_PRIME 0x100000001b3ULL
+
+/* =============================================================
+
+   STEADY-STATE LOOP ACCELERATION
+
+   ============================================================= */
+
+void sim_pipe::set_loop_acceleration(bool enable){
+	delete loop;
+	loop = NULL;
+	if (!enable) return;
+	loop = new loop_state_t;
+	loop_reset();
+}
+
+void sim_pipe::loop_reset(){
+	loop->tracking = 0;
+	memset(loop->memo_signature, 0, sizeof(loop->memo_signature));
+	loop->paths.clear();
+	loop->max_instructions = 0;
+	loop->backoff = 0;
+	loop->penalty = 1;
+	loop->undo.clear();
+	loop->accelerated = 0;
+	loop->rollbacks = 0;
+}
+
+unsigned sim_pipe::get_accelerated_iterations(){return (loop != NULL) ? loop->accelerated : 0;}
+
+unsigned sim_pipe::get_loop_rollbacks(){return (loop != NULL) ? loop->rollbacks : 0;}
+
+/* adds a branch leaving the pipeline (or executed functionally) to the hash of an iteration: from the same target, */
+/* the branches and their outcomes identify the instruction stream */
+static void loop_hash(result_key_t *hash, const instruction_t &instr, int taken){
+	// FNV-1a over words rather than bytes: it runs for every branch written back
+	unsigned long long fields[4] = {instr.opcode, instr.src1, instr.immediate, (unsigned long long) taken};
+	for (unsigned i=0; i<4; i++){
+		hash->h1 = (hash->h1 ^ fields[i]) * LOOP_HASH_PRIME;
+		hash->h2 = (hash->h2 ^ (fields[i] + i)) * LOOP_HASH_PRIME;
+	}
+}
+
+static bool same_instruction(const instruction_t &a, const instruction_t &b){
+	return (a.opcode == b.opcode && a.src1 == b.src1 && a.src2 == b.src2 && a.dest == b.dest && a.immediate == b.immediate);
+}
+
+/* hashes the branch written back in this cycle (called before the WB stage) */
+void sim_pipe::loop_commit(){
+	if (loop->tracking && is_branch(ir[MEM].opcode)) loop_hash(&loop->hash, ir[MEM], sp_registers[COND][WB]==0);
+}
+
+/* executes the instruction at "pc" on the architectural state, logging the overwritten values, and moves "pc" to the next one */
+/* returns 0, without side effects, if the instruction cannot be executed functionally (EOP, invalid address) */
+int sim_pipe::execute_functional(unsigned *pc, int *taken){
+	unsigned index = (*pc - instr_base_address)/4;
+	if (*pc < instr_base_address || index >= PROGRAM_SIZE) return 0;
+	const instruction_t &instr = instr_memory[index];
+	opcode_t opcode = instr.opcode;
+	undo_entry_t undo;
+	*taken = 0;
+	if (is_int_r(opcode) || is_int_imm(opcode)){
+		undo.memory = 0;
+		undo.index = instr.dest;
+		undo.value = gp_registers[instr.dest];
+		loop->undo.push_back(undo);
+		gp_registers[instr.dest] = alu(opcode, gp_registers[instr.src1], is_int_r(opcode) ? gp_registers[instr.src2] : 0, instr.immediate, *pc+4);
+	} else if (is_memory(opcode)){
+		unsigned address = alu(opcode, gp_registers[instr.src1], 0, instr.immediate, *pc+4);
+		if (data_memory_size < 4 || address > data_memory_size - 4) return 0;
+		if (opcode == LW){
+			undo.memory = 0;
+			undo.index = instr.dest;
+			undo.value = gp_registers[instr.dest];
+			loop->undo.push_back(undo);
+			gp_registers[instr.dest] = load_word(&data_memory[address]);
+		} else {
+			for (unsigned i=0; i<4; i++){
+				undo.memory = 1;
+				undo.index = address + i;
+				undo.value = data_memory[address + i];
+				loop->undo.push_back(undo);
+			}
+			write_memory(address, gp_registers[instr.src2]);
+		}
+	} else if (is_branch(opcode)){
+		*taken = taken_branch(opcode, (opcode == JUMP) ? 0 : gp_registers[instr.src1]);
+		if (*taken){
+			*pc = alu(opcode, 0, 0, instr.immediate, *pc+4);
+			return 1;
+		}
+	} else {
+		return 0; //EOP, or outside the program
+	}
+	*pc += 4;
+	return 1;
+}
+
+/* executes one iteration of the memoized loop functionally; rolls it back and returns -1 if it does not follow a memoized path, */
+/* else returns the path */
+int sim_pipe::loop_iteration(){
+	result_key_t hash;
+	result_key_init(&hash);
+	loop_hash(&hash, ir[MEM], 1); //the loop branch in MEM/WB starts the iteration
+	unsigned target = sp_registers[ALU_OUTPUT][WB];
+	unsigned branch_pc = target - ir[MEM].immediate - 4;
+	unsigned pc = target;
+	int ok = 1;
+	loop->undo.clear();
+	for (unsigned n=1; n<loop->max_instructions && ok && pc != branch_pc; n++){
+		unsigned index = (pc - instr_base_address)/4;
+		int taken;
+		ok = execute_functional(&pc, &taken);
+		if (ok && is_branch(instr_memory[index].opcode)) loop_hash(&hash, instr_memory[index], taken);
+	}
+	// the iteration must end with the loop branch, taken again
+	if (ok){
+		unsigned index = (pc - instr_base_address)/4;
+		ok = (pc == branch_pc && pc >= instr_base_address && index < PROGRAM_SIZE && same_instruction(instr_memory[index], ir[MEM])
+		      && taken_branch(ir[MEM].opcode, gp_registers[ir[MEM].src1]));
+	}
+	for (unsigned p=0; ok && p<loop->paths.size(); p++)
+		if (hash.h1 == loop->paths[p].hash.h1 && hash.h2 == loop->paths[p].hash.h2) return p;
+	for (int i=loop->undo.size()-1; i>=0; i--){
+		undo_entry_t *u = &loop->undo[i];
+		if (u->memory) data_memory[u->index] = u->value;
+		else gp_registers[u->index] = u->value;
+	}
+	loop->rollbacks++;
+	return -1;
+}
+
+/* memoizes the detailed iteration that just ended, from and back to "signature" */
+void sim_pipe::loop_memoize(const unsigned *signature){
+	if (memcmp(signature, loop->memo_signature, sizeof(loop->memo_signature)) != 0){
+		memcpy(loop->memo_signature, signature, sizeof(loop->memo_signature));
+		loop->paths.clear();
+		loop->max_instructions = 0;
+		loop->backoff = 0;
+		loop->penalty = 1;
+	}
+	for (unsigned p=0; p<loop->paths.size(); p++)
+		if (loop->hash.h1 == loop->paths[p].hash.h1 && loop->hash.h2 == loop->paths[p].hash.h2) return;
+	if (loop->paths.size() == LOOP_MAX_PATHS) loop->paths.erase(loop->paths.begin());
+	loop_path_t path;
+	path.hash = loop->hash;
+	path.cycles = clock_cycles - loop->start_cycles;
+	path.stalls = stalls - loop->start_stalls;
+	path.instructions = instructions_executed - loop->start_instructions;
+	loop->paths.push_back(path);
+	loop->max_instructions = 0;
+	for (unsigned p=0; p<loop->paths.size(); p++)
+		if (loop->paths[p].instructions > loop->max_instructions) loop->max_instructions = loop->paths[p].instructions;
+}
+
+/* state of the pipeline at the write back of a branch (latched opcodes, hazard bits, latency tracker, branch and fetch addresses) */
+void sim_pipe::pipeline_signature(unsigned *signature){
+	unsigned s[LOOP_SIGNATURE_SIZE] = {
+		ir[IF].opcode, ir[ID].opcode, ir[EXE].opcode, ir[MEM].opcode,
+		(unsigned) raw_hazard, (unsigned) raw_hazard_propagate, (unsigned) raw_hazard_propagate_2,
+		(unsigned) control_hazard, (unsigned) control_hazard_propagate, (unsigned) control_hazard_propagate_2, (unsigned) control_hazard_propagate_3,
+		(unsigned) structural_mem_hazard, (unsigned) mem_hazard_pipe_freeze, latency_tracker,
+		sp_registers[ALU_OUTPUT][WB], sp_registers[PC][IF]
+	};
+	memcpy(signature, s, sizeof(s));
+}
+
+/* called at the beginning of every clock cycle: detects steady-state iterations of a loop and skips them */
+/* "limit" is the clock cycle at which run() has to return (UNDEFINED: run to completion) */
+void sim_pipe::loop_boundary(unsigned limit){
+	// taken backward branch about to be written back
+	if (sp_registers[COND][WB] != 0 || !is_branch(ir[MEM].opcode) || ir[MEM].opcode == JUMP || (int) ir[MEM].immediate >= 0) return;
+	// with the other memory models the timing depends on the addresses
+	if (num_mshrs > 0 || store_buffer_size > 0 || data_prefetcher != NULL || backend != default_backend || icache != NULL || mmio != NULL || check != NULL || mem_trace != NULL || energy != NULL || limit_study != NULL || btc != NULL) return;
+
+	unsigned signature[LOOP_SIGNATURE_SIZE];
+	pipeline_signature(signature);
+
+	if (loop->tracking && memcmp(signature, loop->signature, sizeof(signature)) == 0){
+		// one detailed iteration from this very state: memoize it and skip the following ones while they follow a memoized path
+		loop_memoize(signature);
+		if (loop->backoff > 0) loop->backoff--;
+		else {
+			// the longest path must fit before the limit: the path is only known once the iteration has been executed
+			unsigned longest = 0;
+			for (unsigned p=0; p<loop->paths.size(); p++)
+				if (loop->paths[p].cycles > longest) longest = loop->paths[p].cycles;
+			unsigned credited = 0;
+			int p = 0;
+			while (limit == UNDEFINED || clock_cycles + longest < limit){
+				if ((p = loop_iteration()) < 0) break;
+				clock_cycles += loop->paths[p].cycles;
+				stalls += loop->paths[p].stalls;
+				instructions_executed += loop->paths[p].instructions;
+				loop->accelerated++;
+				credited++;
+			}
+			// an attempt ending in a rollback wastes a functional iteration: back off unless it credited a few
+			if (p < 0 && credited < 2){
+				loop->backoff = loop->penalty;
+				if (loop->penalty < LOOP_MAX_BACKOFF) loop->penalty *= 2;
+			} else if (credited >= 2) loop->penalty = 1;
+		}
+	}
+
+	// open the window of the next (detailed) iteration
+	loop->tracking = 1;
+	memcpy(loop->signature, signature, sizeof(signature));
+	loop->start_cycles = clock_cycles;
+	loop->start_stalls = stalls;
+	loop->start_instructions = instructions_executed;
+	result_key_init(&loop->hash);
+}
@@ -0,0 +1,72 @@
+#ifndef SIM_LOOP_H_
+#define SIM_LOOP_H_
+
+#include "sim_pipe.h"
+#include "result_cache.h"
+#include <vector>
+
+using namespace std;
+
+/*
+State of the steady-state loop acceleration (sim_pipe::set_loop_acceleration).
+
+When a taken backward branch is about to be written back, the branch is in MEM/WB, the two younger
+latches hold the bubbles of the control hazard and IF/ID holds the branch target: the pipeline state
+does not depend on data values and is captured by a signature (latched opcodes, hazard bits, latency
+tracker, branch target). If the signature repeats at the next write back of the same branch, the detailed
+iteration in between is memoized (cycles, stalls, instructions and a hash of the branches written back and
+their outcomes, which identify the instruction stream from the branch target). The following iterations are
+executed functionally, and each one whose branches hash to a memoized iteration is credited its counts. An
+iteration that follows another path is rolled back with an undo log and simulated in detail. Up to
+LOOP_MAX_PATHS iterations are memoized from the same signature, one per path through the body, so a loop
+whose inner branches follow a pattern is credited on every path once each has been seen. After an attempt
+that credits less than two iterations before a rollback, the following attempts are skipped for a back-off
+that doubles (up to LOOP_MAX_BACKOFF boundaries) until an attempt succeeds. Only used with the default
+memory model (fixed latency, blocking memory stage, no store buffer, prefetcher, instruction cache or
+devices), where timing depends on the instruction stream only.
+*/
+
+#define LOOP_SIGNATURE_SIZE 16
+#define LOOP_MAX_PATHS 8 //memoized iterations from a signature
+#define LOOP_MAX_BACKOFF 64 //boundaries skipped after fruitless attempts
+
+/* register or data memory byte overwritten by a functional iteration */
+typedef struct{
+	int memory; //1: data memory byte, 0: general purpose register
+	unsigned index;
+	int value; //previous value
+} undo_entry_t;
+
+/* detailed iteration from the memoized signature back to it */
+typedef struct{
+	result_key_t hash; //branches and outcomes
+	unsigned cycles;
+	unsigned stalls;
+	unsigned instructions;
+} loop_path_t;
+
+typedef struct loop_state{
+	int tracking; //a boundary has been seen and the window below is open
+	unsigned signature[LOOP_SIGNATURE_SIZE];
+	unsigned start_cycles;
+	unsigned start_stalls;
+	unsigned start_instructions;
+	result_key_t hash; //branches written back since the boundary
+
+	//memoized iterations, all from (and back to) "memo_signature"
+	unsigned memo_signature[LOOP_SIGNATURE_SIZE];
+	vector<loop_path_t> paths;
+	unsigned max_instructions; //of the paths
+
+	//back-off after the attempts that credit less than two iterations
+	unsigned backoff; //boundaries left before the next attempt
+	unsigned penalty; //back-off after the next fruitless attempt
+
+	vector<undo_entry_t> undo;
+
+	//statistics
+	unsigned accelerated; //iterations credited without detailed simulation
+	unsigned rollbacks; //functional iterations that did not match the memoized one
+} loop_state_t;
+
+#endif /*SIM_LOOP_H_*/
@@ -0,0 +1,312 @@
+#include "sim_mt.h"
+#include "mem_backend.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/* =============================================================
+
+   MULTITHREADED CORE
+
+   ============================================================= */
+
+sim_mt::sim_mt(unsigned threads, unsigned data_mem_size, unsigned data_mem_latency, fetch_policy_t fetch_policy){
+	if (threads == 0){
+		cerr << "error: the core needs at least one thread context" << endl;
+		exit(-1);
+	}
+	num_threads = threads;
+	contexts = new mt_context_t[threads];
+	for (unsigned t=0; t<threads; t++) contexts[t].loaded = 0;
+	decoder = new sim_pipe(0, data_mem_latency);
+	data_memory_size = data_mem_size;
+	data_memory_latency = data_mem_latency;
+	data_memory = new unsigned char[data_mem_size];
+	default_backend = new fixed_latency_backend(data_mem_latency);
+	backend = default_backend;
+	policy = fetch_policy;
+	reset();
+}
+
+sim_mt::~sim_mt(){
+	delete [] contexts;
+	delete decoder;
+	delete [] data_memory;
+	delete default_backend;
+}
+
+void sim_mt::load_program(unsigned thread, const char *filename, unsigned base_address){
+	decoder->load_program(filename, base_address);
+	mt_context_t *c = &contexts[thread];
+	for (unsigned i=0; i<PROGRAM_SIZE; i++) c->instr_memory[i] = decoder->instr_memory[i];
+	c->instr_base_address = base_address;
+	c->pc = base_address;
+	c->loaded = 1;
+	c->done = 0;
+}
+
+void sim_mt::set_fetch_policy(fetch_policy_t fetch_policy){policy = fetch_policy;}
+
+void sim_mt::set_mem_backend(mem_backend *b){
+	backend = (b != NULL) ? b : default_backend;
+	backend->reset();
+}
+
+void sim_mt::bubble(mt_latch_t *l){
+	l->thread = UNDEFINED;
+	l->instr.opcode = NOP;
+	l->instr.src1 = UNDEFINED;
+	l->instr.src2 = UNDEFINED;
+	l->instr.dest = UNDEFINED;
+	l->instr.immediate = UNDEFINED;
+	l->pc = UNDEFINED;
+	l->a = UNDEFINED;
+	l->b = UNDEFINED;
+	l->alu_output = UNDEFINED;
+	l->lmd = UNDEFINED;
+}
+
+void sim_mt::reset(){
+	memset(data_memory, 0xFF, data_memory_size);
+	for (unsigned t=0; t<num_threads; t++){
+		mt_context_t *c = &contexts[t];
+		for (unsigned r=0; r<NUM_GP_REGISTERS; r++) c->gp_registers[r] = UNDEFINED;
+		c->pc = c->loaded ? c->instr_base_address : UNDEFINED;
+		c->eop_fetched = 0;
+		c->done = !c->loaded;
+		c->in_flight = 0;
+		c->mem_ready = UNDEFINED;
+		c->instructions_executed = 0;
+		c->finish_cycle = 0;
+		c->memory_wait_cycles = 0;
+		c->flushed = 0;
+	}
+	for (unsigned i=0; i<NUM_STAGES-1; i++) bubble(&ir[i]);
+	freeze_until = UNDEFINED;
+	backend->reset();
+	last_fetched = UNDEFINED;
+	clock_cycles = 0;
+	stalls = 0;
+}
+
+/* removes the instructions of "thread" in IF/ID and ID/EX (younger than the one in the MEM stage); the thread fetches them again */
+void sim_mt::flush_younger(unsigned thread){
+	mt_context_t *c = &contexts[thread];
+	for (unsigned k=IF; k<=ID; k++){
+		if (ir[k].thread != thread) continue;
+		c->pc = ir[k].pc; //ends with the oldest flushed instruction
+		bubble(&ir[k]);
+		c->in_flight--;
+		c->flushed++;
+	}
+	c->eop_fetched = 0;
+}
+
+/* moves the access in the MEM stage out of the pipeline until clock cycle "ready" */
+void sim_mt::park(unsigned thread, unsigned ready){
+	mt_context_t *c = &contexts[thread];
+	c->mem_access = ir[EXE];
+	c->mem_ready = ready;
+	c->in_flight--;
+	flush_younger(thread);
+	bubble(&ir[EXE]);
+}
+
+/* a thread can fetch if it has not fetched its EOP, is not waiting for the data memory and has no unresolved branch */
+int sim_mt::can_fetch(unsigned thread){
+	mt_context_t *c = &contexts[thread];
+	if (c->done || c->eop_fetched || c->mem_ready != UNDEFINED) return 0;
+	for (unsigned k=IF; k<=EXE; k++)
+		if (ir[k].thread == thread && is_branch(ir[k].instr.opcode)) return 0;
+	return 1;
+}
+
+/* another thread can fetch (now or once its branches resolve) and use the slots freed by parking "thread" */
+int sim_mt::others_fetching(unsigned thread){
+	for (unsigned t=0; t<num_threads; t++){
+		mt_context_t *c = &contexts[t];
+		if (t != thread && !c->done && !c->eop_fetched && c->mem_ready == UNDEFINED) return 1;
+	}
+	return 0;
+}
+
+/* returns the thread fetching in this clock cycle according to the policy, UNDEFINED if none can */
+int sim_mt::select_thread(){
+	unsigned first = (last_fetched == UNDEFINED) ? 0 : last_fetched + 1;
+	if (policy == SWITCH_ON_MISS && last_fetched != UNDEFINED){
+		// the current thread keeps the fetch, waiting for its branches, until it is parked or has fetched its EOP
+		mt_context_t *c = &contexts[last_fetched];
+		if (!c->done && !c->eop_fetched && c->mem_ready == UNDEFINED) return can_fetch(last_fetched) ? (int) last_fetched : (int) UNDEFINED;
+	}
+	int selected = UNDEFINED;
+	for (unsigned i=0; i<num_threads; i++){
+		unsigned t = (first + i) % num_threads;
+		if (!can_fetch(t)) continue;
+		if (policy != ICOUNT) return t;
+		if (selected == (int) UNDEFINED || contexts[t].in_flight < contexts[selected].in_flight) selected = t;
+	}
+	return selected;
+}
+
+/* runs the core; stages are processed from WB back to IF so that each one sees the latches of the previous cycle */
+void sim_mt::run(unsigned cycles){
+
+	unsigned start_cycles = clock_cycles;
+
+	while(cycles==0 || clock_cycles-start_cycles!=cycles){
+
+		/* accesses completing outside the pipeline */
+		for (unsigned t=0; t<num_threads; t++){
+			mt_context_t *c = &contexts[t];
+			if (c->mem_ready == UNDEFINED) continue;
+			if (c->mem_ready == clock_cycles){
+				if (c->mem_access.instr.opcode == LW) c->gp_registers[c->mem_access.instr.dest] = c->mem_access.lmd;
+				c->instructions_executed++;
+				c->mem_ready = UNDEFINED;
+			} else {
+				c->memory_wait_cycles++;
+			}
+		}
+
+		/* ============   WB stage   ============  */
+		mt_latch_t *l = &ir[MEM];
+		if (l->instr.opcode != NOP){
+			mt_context_t *c = &contexts[l->thread];
+			c->in_flight--;
+			if (l->instr.opcode == EOP){
+				c->done = 1;
+				c->finish_cycle = clock_cycles;
+			} else {
+				if (is_int_r(l->instr.opcode) || is_int_imm(l->instr.opcode)) c->gp_registers[l->instr.dest] = l->alu_output;
+				if (l->instr.opcode == LW) c->gp_registers[l->instr.dest] = l->lmd;
+				c->instructions_executed++;
+			}
+			bubble(l);
+		}
+		int finished = 1;
+		for (unsigned t=0; t<num_threads; t++) if (!contexts[t].done) finished = 0;
+		if (finished) break;
+
+		/* ============   MEM stage   ============  */
+		l = &ir[EXE];
+		if (freeze_until == UNDEFINED && is_memory(l->instr.opcode)){
+			unsigned address = l->alu_output;
+			if (data_memory_size < 4 || address > data_memory_size - 4){
+				cerr << "error: thread " << l->thread << " accesses address 0x" << hex << address << dec << " outside the data memory" << endl;
+				exit(-1);
+			}
+			if (l->instr.opcode == SW) write_memory(address, l->b);
+			else l->lmd = load_word(&data_memory[address]);
+			unsigned latency = backend->access(address, l->instr.opcode == SW, clock_cycles);
+			if (latency > 0) freeze_until = clock_cycles + latency;
+		}
+		if (freeze_until != UNDEFINED){
+			if (clock_cycles < freeze_until && others_fetching(l->thread)){
+				// the thread is parked until the access completes; the others keep the pipeline busy
+				park(l->thread, freeze_until + 1);
+				freeze_until = UNDEFINED;
+			} else if (clock_cycles < freeze_until){
+				// nobody can use the slots: the access stays in the MEM stage and the younger stages are frozen
+				bubble(&ir[MEM]);
+				contexts[l->thread].memory_wait_cycles++;
+				stalls++;
+				clock_cycles++;
+				continue;
+			} else {
+				freeze_until = UNDEFINED;
+			}
+		}
+		ir[MEM] = ir[EXE];
+
+		/* ============   EXE stage   ============  */
+		l = &ir[ID];
+		if (l->instr.opcode != NOP && l->instr.opcode != EOP){
+			l->alu_output = alu(l->instr.opcode, l->a, l->b, l->instr.immediate, l->pc+4);
+			if (is_branch(l->instr.opcode))
+				contexts[l->thread].pc = taken_branch(l->instr.opcode, l->a) ? l->alu_output : l->pc+4;
+		}
+		ir[EXE] = ir[ID];
+
+		/* ============   ID stage   ============  */
+		// one stall for each instruction of the same thread in flight writing a source register
+		l = &ir[IF];
+		unsigned hazards = 0;
+		for (unsigned k=EXE; k<=MEM; k++)
+			if (ir[k].thread == l->thread && writes_register(ir[k].instr, ir[k].instr.dest) && reads_register(l->instr, ir[k].instr.dest)) hazards++;
+		if (hazards > 0){
+			bubble(&ir[ID]);
+			stalls += hazards;
+			clock_cycles++;
+			continue;
+		}
+		ir[ID] = ir[IF];
+		if (l->instr.opcode != NOP){
+			mt_context_t *c = &contexts[l->thread];
+			if (reads_register(l->instr, l->instr.src1) && l->instr.opcode != JUMP) ir[ID].a = c->gp_registers[l->instr.src1];
+			if (is_int_r(l->instr.opcode) || l->instr.opcode == SW) ir[ID].b = c->gp_registers[l->instr.src2];
+		}
+
+		/* ============   IF stage   ============  */
+		bubble(&ir[IF]);
+		int t = select_thread();
+		if (t == (int) UNDEFINED){
+			// no thread can fetch: a stall unless all the remaining ones have fetched their EOP
+			for (unsigned i=0; i<num_threads; i++)
+				if (!contexts[i].done && !contexts[i].eop_fetched){
+					stalls++;
+					break;
+				}
+		} else {
+			mt_context_t *c = &contexts[t];
+			unsigned index = (c->pc - c->instr_base_address)/4;
+			if (c->pc < c->instr_base_address || index >= PROGRAM_SIZE){
+				cerr << "error: thread " << t << " fetches from address 0x" << hex << c->pc << dec << " outside its program" << endl;
+				exit(-1);
+			}
+			ir[IF].thread = t;
+			ir[IF].instr = c->instr_memory[index];
+			ir[IF].pc = c->pc;
+			if (ir[IF].instr.opcode == EOP) c->eop_fetched = 1;
+			else c->pc += 4;
+			c->in_flight++;
+			last_fetched = t;
+		}
+
+		clock_cycles++;
+	}
+}
+
+int sim_mt::get_gp_register(unsigned thread, unsigned reg){return contexts[thread].gp_registers[reg];}
+
+void sim_mt::set_gp_register(unsigned thread, unsigned reg, int value){contexts[thread].gp_registers[reg] = value;}
+
+unsigned sim_mt::get_clock_cycles(){return clock_cycles;}
+
+unsigned sim_mt::get_stalls(){return stalls;}
+
+float sim_mt::get_IPC(){
+	unsigned instructions = 0;
+	for (unsigned t=0; t<num_threads; t++) instructions += contexts[t].instructions_executed;
+	return (float)instructions/clock_cycles;
+}
+
+unsigned sim_mt::get_instructions_executed(unsigned thread){return contexts[thread].instructions_executed;}
+
+float sim_mt::get_IPC(unsigned thread){return (float)contexts[thread].instructions_executed/clock_cycles;}
+
+unsigned sim_mt::get_finish_cycle(unsigned thread){return contexts[thread].finish_cycle;}
+
+unsigned sim_mt::get_memory_wait_cycles(unsigned thread){return contexts[thread].memory_wait_cycles;}
+
+unsigned sim_mt::get_flushed_instructions(unsigned thread){return contexts[thread].flushed;}
+
+void sim_mt::print_memory(unsigned start_address, unsigned end_address){
+	print_data_memory(data_memory, start_address, end_address);
+}
+
+/* little-endian, as sim_pipe::write_memory */
+void sim_mt::write_memory(unsigned address, unsigned value){
+	memcpy(&data_memory[address], &value, sizeof value);
+}
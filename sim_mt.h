@@ -0,0 +1,144 @@
+#ifndef SIM_MT_H_
+#define SIM_MT_H_
+
+#include "sim_pipe.h"
+
+using namespace std;
+
+/*
+Multithreaded core: K hardware thread contexts, each with its own program, PC and general purpose
+registers, share the five stages of the pipeline and the data memory.
+
+The pipeline is the one of sim_pipe::run (no forwarding, registers read in ID and written in WB, branches
+resolved in EXE), with every latch tagged by the thread of its instruction: hazards are only checked
+between instructions of the same thread. In every clock cycle the fetch policy picks the thread that fetches:
+- ROUND_ROBIN: the next thread able to fetch after the one that fetched last;
+- SWITCH_ON_MISS: the same thread until it waits for the data memory, then the next one able to fetch;
+- ICOUNT: the thread able to fetch with the fewest instructions in the pipeline.
+A thread cannot fetch while one of its branches is unresolved or while it waits for the data memory.
+An access that does not complete in the MEM stage leaves the pipeline and parks its thread until the access
+completes: the younger instructions of the thread are flushed and fetched again afterwards, while the other
+threads keep the pipeline busy. While no other thread can fetch, the access stays in the MEM stage and freezes
+the pipeline as in sim_pipe::run.
+*/
+
+class mem_backend;
+
+typedef enum {ROUND_ROBIN, SWITCH_ON_MISS, ICOUNT} fetch_policy_t;
+
+/* pipeline latch, tagged with the thread of its instruction */
+typedef struct{
+	unsigned thread;
+	instruction_t instr; //NOP = bubble
+	unsigned pc;
+	unsigned a, b; //source operands read in ID
+	unsigned alu_output;
+	unsigned lmd; //word read by a LW
+} mt_latch_t;
+
+/* hardware thread context */
+typedef struct{
+	int loaded; //a program has been loaded
+	instruction_t instr_memory[PROGRAM_SIZE];
+	unsigned instr_base_address;
+	int gp_registers[NUM_GP_REGISTERS];
+	unsigned pc; //next instruction to fetch
+	int eop_fetched;
+	int done; //EOP written back
+	unsigned in_flight; //instructions in the pipeline latches
+
+	//access waiting for the data memory outside the pipeline
+	unsigned mem_ready; //clock cycle in which it completes (UNDEFINED if none)
+	mt_latch_t mem_access;
+
+	//statistics
+	unsigned instructions_executed;
+	unsigned finish_cycle; //clock cycle in which EOP was written back
+	unsigned memory_wait_cycles; //clock cycles parked or frozen waiting for the data memory
+	unsigned flushed; //instructions flushed (and fetched again) because of an access waiting for the data memory
+} mt_context_t;
+
+class sim_mt{
+
+	unsigned num_threads;
+	mt_context_t *contexts;
+	sim_pipe *decoder; //parses the programs
+
+	//data memory, shared by the threads
+	unsigned char *data_memory;
+	unsigned data_memory_size;
+	unsigned data_memory_latency;
+	mem_backend *backend;
+	mem_backend *default_backend;
+
+	fetch_policy_t policy;
+	unsigned last_fetched; //thread that fetched last (UNDEFINED before the first fetch)
+
+	mt_latch_t ir[NUM_STAGES-1]; //IF/ID, ID/EX, EX/MEM, MEM/WB
+	unsigned freeze_until; //clock cycle in which the access freezing the pipeline leaves the MEM stage (UNDEFINED if none)
+
+	//statistics
+	unsigned clock_cycles;
+	unsigned stalls;
+
+	void bubble(mt_latch_t *l);
+	void flush_younger(unsigned thread);
+	void park(unsigned thread, unsigned ready);
+	int can_fetch(unsigned thread);
+	int others_fetching(unsigned thread);
+	int select_thread();
+
+public:
+
+	//instantiates a core with "threads" hardware contexts and a data memory of given size (in bytes) and latency (in clock cycles)
+	sim_mt(unsigned threads, unsigned data_mem_size, unsigned data_mem_latency, fetch_policy_t policy=ROUND_ROBIN);
+
+	//de-allocates the core
+	~sim_mt();
+
+	//loads the assembly program in file "filename" in the instruction memory of "thread" at the specified address
+	//threads without a program stay idle
+	void load_program(unsigned thread, const char *filename, unsigned base_address=0x0);
+
+	//selects the fetch policy
+	void set_fetch_policy(fetch_policy_t policy);
+
+	//selects the timing model of the data memory; NULL restores the fixed data_memory_latency (the backend is not owned by the core)
+	void set_mem_backend(mem_backend *backend);
+
+	//runs the core for "cycles" clock cycles (until every thread has written back its EOP if cycles=0)
+	void run(unsigned cycles=0);
+
+	//resets registers (UNDEFINED), data memory (0xFF), pipeline and statistics; the programs are preserved
+	void reset();
+
+	//returns/sets the value of a general purpose register of a thread
+	int get_gp_register(unsigned thread, unsigned reg);
+	void set_gp_register(unsigned thread, unsigned reg, int value);
+
+	//returns the number of clock cycles
+	unsigned get_clock_cycles();
+
+	//returns the number of stalls: bubbles inserted by ID (one per pending RAW producer, as in sim_pipe) plus
+	//clock cycles in which no thread can fetch or the pipeline is frozen by an access
+	unsigned get_stalls();
+
+	//returns the aggregate IPC (instructions of all the threads per clock cycle)
+	float get_IPC();
+
+	//per-thread statistics: instructions executed, IPC over the whole run, clock cycle in which the thread
+	//completed, clock cycles waiting for the data memory, instructions flushed and fetched again
+	unsigned get_instructions_executed(unsigned thread);
+	float get_IPC(unsigned thread);
+	unsigned get_finish_cycle(unsigned thread);
+	unsigned get_memory_wait_cycles(unsigned thread);
+	unsigned get_flushed_instructions(unsigned thread);
+
+	//prints the content of the data memory within the specified address range
+	void print_memory(unsigned start_address, unsigned end_address);
+
+	// writes an integer value to data memory at the specified address (little-endian)
+	void write_memory(unsigned address, unsigned value);
+};
+
+#endif /*SIM_MT_H_*/
@@ -0,0 +1,240 @@
+#include "sim_ooo.h"
+#include "mem_backend.h"
+#include "prefetcher.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/* =============================================================
+
+   OUT-OF-ORDER CORE
+
+   ============================================================= */
+
+/* returns true if the instruction reads src1 (A) / src2 (B) */
+static bool uses_src1(opcode_t opcode){
+	return (is_int_r(opcode) || is_int_imm(opcode) || is_memory(opcode) || (is_branch(opcode) && opcode != JUMP));
+}
+
+static bool uses_src2(opcode_t opcode){
+	return (is_int_r(opcode) || opcode == SW);
+}
+
+/* (re)allocates the out-of-order core with the given window; a zero-sized window releases it */
+void sim_pipe::ooo_allocate(unsigned rob_size, unsigned rs_size, unsigned width){
+	if (ooo != NULL){
+		delete [] ooo->rob;
+		delete [] ooo->rs;
+		delete [] ooo->fetch_queue;
+		delete ooo;
+		ooo = NULL;
+	}
+	if (rob_size == 0) return;
+	ooo = new ooo_state_t;
+	ooo->rob_size = rob_size;
+	ooo->rs_size = rs_size;
+	ooo->width = width;
+	ooo->rob = new rob_entry_t[rob_size];
+	ooo->rs = new rs_entry_t[rs_size];
+	ooo->fetch_queue = new fetch_entry_t[width];
+	ooo_reset();
+}
+
+/* empties the window and the front end */
+void sim_pipe::ooo_reset(){
+	ooo->rob_head = 0;
+	ooo->rob_count = 0;
+	for (unsigned i=0; i<ooo->rs_size; i++) ooo->rs[i].valid = 0;
+	for (int i=0; i<NUM_GP_REGISTERS; i++) ooo->rat[i] = OOO_NO_TAG;
+	ooo->fq_count = 0;
+	ooo->fetch_pc = UNDEFINED;
+	ooo->fetch_stalled = 0;
+	ooo->eop_fetched = 0;
+	ooo->started = 0;
+	ooo->committed = 0;
+}
+
+void sim_pipe::set_ooo_window(unsigned rob_size, unsigned rs_size, unsigned width){
+	if (rob_size > 0 && (rs_size == 0 || width == 0)){
+		cerr << "error: the out-of-order core needs at least one reservation station and a non-zero width" << endl;
+		exit(-1);
+	}
+	ooo_allocate(rob_size, rs_size, width);
+}
+
+/* reads the word loaded by the LW in reorder buffer entry "rob_index"
+   older SW still in the reorder buffer are checked youngest first: the load waits (returns 0) if one of them has an unknown address
+   or overlaps the word but has not executed yet; each byte is forwarded from the youngest one covering it, or read from the data memory */
+int sim_pipe::ooo_load(unsigned rob_index, unsigned address, unsigned *value){
+	unsigned age = (rob_index + ooo->rob_size - ooo->rob_head) % ooo->rob_size;
+	unsigned char bytes[4];
+	int forwarded[4] = {0, 0, 0, 0};
+	for (int i=age-1; i>=0; i--){
+		rob_entry_t *older = &ooo->rob[(ooo->rob_head + i) % ooo->rob_size];
+		if (older->instr.opcode != SW) continue;
+		if (!older->address_ready) return 0;
+		if (address + 4 <= older->address || address >= older->address + 4) continue;
+		if (!older->done) return 0;
+		for (unsigned b=0; b<4; b++){
+			if (forwarded[b] || address + b < older->address || address + b >= older->address + 4) continue;
+			bytes[b] = (older->value >> (8 * (address + b - older->address))) & 0xFF;
+			forwarded[b] = 1;
+		}
+	}
+	for (unsigned b=0; b<4; b++) if (!forwarded[b]) bytes[b] = data_memory[address + b];
+	*value = load_word(bytes);
+	return 1;
+}
+
+/* runs the out-of-order core; stages are processed from commit back to fetch so that each one sees the state of the previous cycle */
+void sim_pipe::run_ooo(unsigned cycles){
+
+	if (ooo == NULL) ooo_allocate(16, 8, 1);
+
+	unsigned start_cycles = clock_cycles;
+	if (!ooo->started){
+		ooo->fetch_pc = start_pc();
+		ooo->started = 1;
+	}
+
+	while(cycles==0 || clock_cycles-start_cycles!=cycles){
+
+		/* ============   COMMIT   ============  */
+		unsigned committed = 0;
+		int finished = 0;
+		while (committed < ooo->width && ooo->rob_count > 0){
+			rob_entry_t *head = &ooo->rob[ooo->rob_head];
+			if (head->instr.opcode == EOP){
+				finished = 1;
+				break;
+			}
+			if (!head->done) break;
+			if (head->instr.opcode == SW){
+				write_memory(head->address, head->value);
+			} else if (writes_register(head->instr, head->instr.dest)){
+				set_gp_register(head->instr.dest, head->value);
+				if (ooo->rat[head->instr.dest] == (int)ooo->rob_head) ooo->rat[head->instr.dest] = OOO_NO_TAG;
+			}
+			instructions_executed++;
+			committed++;
+			ooo->rob_head = (ooo->rob_head + 1) % ooo->rob_size;
+			ooo->rob_count--;
+		}
+		if (finished) break;
+		if (committed > 0) ooo->committed = 1;
+		else if (ooo->committed) stalls++;
+
+		/* ============   WRITE RESULT (common data bus)   ============  */
+		for (unsigned i=0; i<ooo->rs_size; i++){
+			rs_entry_t *rs = &ooo->rs[i];
+			if (!rs->valid || !rs->executing || rs->finish_cycle > clock_cycles) continue;
+			rob_entry_t *entry = &ooo->rob[rs->rob];
+			entry->done = 1;
+			rs->valid = 0;
+			if (is_branch(entry->instr.opcode)){
+				ooo->fetch_pc = entry->target;
+				ooo->fetch_stalled = 0;
+			}
+			if (!writes_register(entry->instr, entry->instr.dest)) continue;
+			// wake up the instructions waiting for this result
+			for (unsigned j=0; j<ooo->rs_size; j++){
+				if (!ooo->rs[j].valid) continue;
+				if (ooo->rs[j].qj == (int)rs->rob){ ooo->rs[j].vj = entry->value; ooo->rs[j].qj = OOO_NO_TAG; }
+				if (ooo->rs[j].qk == (int)rs->rob){ ooo->rs[j].vk = entry->value; ooo->rs[j].qk = OOO_NO_TAG; }
+			}
+		}
+
+		/* ============   ISSUE / EXECUTE   ============  */
+		// oldest ready instructions first, one memory access per cycle
+		unsigned issued = 0;
+		int lsu_busy = 0;
+		for (unsigned age=0; age<ooo->rob_count && issued<ooo->width; age++){
+			unsigned rob_index = (ooo->rob_head + age) % ooo->rob_size;
+			rs_entry_t *rs = NULL;
+			for (unsigned i=0; i<ooo->rs_size; i++)
+				if (ooo->rs[i].valid && ooo->rs[i].rob == rob_index) rs = &ooo->rs[i];
+			if (rs == NULL || rs->executing || rs->qj != OOO_NO_TAG || rs->qk != OOO_NO_TAG) continue;
+			rob_entry_t *entry = &ooo->rob[rob_index];
+			opcode_t opcode = entry->instr.opcode;
+			unsigned latency = 1;
+			if (is_memory(opcode)){
+				if (lsu_busy) continue;
+				entry->address = alu(opcode, rs->vj, rs->vk, entry->instr.immediate, entry->pc+4);
+				entry->address_ready = 1;
+				if (opcode == SW){
+					entry->value = rs->vk;
+				} else {
+					unsigned lmd;
+					if (!ooo_load(rob_index, entry->address, &lmd)) continue;
+					entry->value = lmd;
+					latency += demand_latency(LW, entry->address, clock_cycles+1);
+				}
+				if (data_prefetcher != NULL) prefetch_train(entry->pc, entry->address, opcode==SW, clock_cycles+1);
+				lsu_busy = 1;
+			} else if (is_branch(opcode)){
+				entry->taken = taken_branch(opcode, rs->vj);
+				entry->target = entry->taken ? alu(opcode, rs->vj, rs->vk, entry->instr.immediate, entry->pc+4) : entry->pc+4;
+			} else {
+				entry->value = alu(opcode, rs->vj, rs->vk, entry->instr.immediate, entry->pc+4);
+			}
+			rs->executing = 1;
+			rs->finish_cycle = clock_cycles + latency;
+			issued++;
+		}
+
+		/* ============   DISPATCH (rename)   ============  */
+		unsigned dispatched = 0;
+		while (dispatched < ooo->fq_count && ooo->rob_count < ooo->rob_size){
+			fetch_entry_t *f = &ooo->fetch_queue[dispatched];
+			rs_entry_t *rs = NULL;
+			if (f->instr.opcode != EOP){
+				for (unsigned i=0; i<ooo->rs_size && rs == NULL; i++)
+					if (!ooo->rs[i].valid) rs = &ooo->rs[i];
+				if (rs == NULL) break;
+			}
+			unsigned rob_index = (ooo->rob_head + ooo->rob_count) % ooo->rob_size;
+			rob_entry_t *entry = &ooo->rob[rob_index];
+			entry->instr = f->instr;
+			entry->pc = f->pc;
+			entry->done = 0;
+			entry->address_ready = 0;
+			entry->taken = 0;
+			ooo->rob_count++;
+			dispatched++;
+			if (rs == NULL) continue;
+			rs->valid = 1;
+			rs->rob = rob_index;
+			rs->executing = 0;
+			rs->qj = rs->qk = OOO_NO_TAG;
+			rs->vj = rs->vk = UNDEFINED;
+			// read the operands from the register file, from a completed reorder buffer entry, or wait for their producer
+			for (int op=0; op<2; op++){
+				if (op == 0 && !uses_src1(f->instr.opcode)) continue;
+				if (op == 1 && !uses_src2(f->instr.opcode)) continue;
+				unsigned reg = (op == 0) ? f->instr.src1 : f->instr.src2;
+				int tag = ooo->rat[reg];
+				unsigned value = get_gp_register(reg);
+				if (tag != OOO_NO_TAG && ooo->rob[tag].done){ value = ooo->rob[tag].value; tag = OOO_NO_TAG; }
+				if (op == 0){ rs->vj = value; rs->qj = tag; }
+				else { rs->vk = value; rs->qk = tag; }
+			}
+			if (writes_register(f->instr, f->instr.dest)) ooo->rat[f->instr.dest] = rob_index;
+		}
+		for (unsigned i=dispatched; i<ooo->fq_count; i++) ooo->fetch_queue[i-dispatched] = ooo->fetch_queue[i];
+		ooo->fq_count -= dispatched;
+
+		/* ============   FETCH   ============  */
+		while (ooo->fq_count < ooo->width && !ooo->fetch_stalled && !ooo->eop_fetched){
+			fetch_entry_t *f = &ooo->fetch_queue[ooo->fq_count++];
+			f->pc = ooo->fetch_pc;
+			f->instr = instr_memory[(ooo->fetch_pc - instr_base_address)/4];
+			ooo->fetch_pc += 4;
+			if (f->instr.opcode == EOP) ooo->eop_fetched = 1;
+			if (is_branch(f->instr.opcode)) ooo->fetch_stalled = 1;
+		}
+
+		clock_cycles++;
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef SIM_OOO_H_
+#define SIM_OOO_H_
+
+#include "sim_pipe.h"
+
+/*
+State of the out-of-order core (sim_pipe::run_ooo):
+Tomasulo-style reservation stations with register renaming onto a reorder buffer and in-order commit.
+Fetch stops at every branch until the branch resolves, so the core never executes down a wrong path.
+*/
+
+#define OOO_NO_TAG -1 //the operand/register value is available (no producer in flight)
+
+/* reorder buffer entry */
+typedef struct{
+	instruction_t instr;
+	unsigned pc;
+	int done; //result available (for SW: address and data known)
+	unsigned value; //destination register value, or data of a SW
+	unsigned address; //effective address of LW/SW
+	int address_ready;
+	int taken; //for branches: 1 if taken
+	unsigned target; //for branches: address of the next instruction
+} rob_entry_t;
+
+/* reservation station entry */
+typedef struct{
+	int valid;
+	unsigned rob; //reorder buffer entry of the instruction
+	unsigned vj, vk; //source operand values (A and B)
+	int qj, qk; //reorder buffer entries producing the source operands, OOO_NO_TAG if available
+	int executing;
+	unsigned finish_cycle; //clock cycle in which the result is broadcast
+} rs_entry_t;
+
+/* fetched instruction waiting to be dispatched */
+typedef struct{
+	instruction_t instr;
+	unsigned pc;
+} fetch_entry_t;
+
+typedef struct ooo_state{
+	//configuration
+	unsigned rob_size;
+	unsigned rs_size;
+	unsigned width; //instructions fetched, dispatched, issued and committed per cycle
+
+	//reorder buffer (circular)
+	rob_entry_t *rob;
+	unsigned rob_head;
+	unsigned rob_count;
+
+	//reservation stations (unified)
+	rs_entry_t *rs;
+
+	//register alias table: reorder buffer entry producing each register
+	int rat[NUM_GP_REGISTERS];
+
+	//front end
+	fetch_entry_t *fetch_queue;
+	unsigned fq_count;
+	unsigned fetch_pc;
+	int fetch_stalled; //waiting for a branch to resolve
+	int eop_fetched;
+
+	int started; //fetch_pc initialized
+	int committed; //at least one instruction committed (stall accounting starts)
+} ooo_state_t;
+
+#endif /*SIM_OOO_H_*/
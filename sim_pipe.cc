@@ -1,4 +1,16 @@
 #include "sim_pipe.h"
+#include "mem_backend.h"
+#include "prefetcher.h"
+#include "sim_icache.h"
+#include "mmio_device.h"
+#include "sim_check.h"
+#include "mem_trace.h"
+#include "sim_xlat.h"
+#include "sim_interval.h"
+#include "sim_energy.h"
+#include "sim_limit.h"
+#include "sim_sched.h"
+#include "sim_btc.h"
 #include <stdlib.h>
 #include <iostream>
 #include <fstream>
@@ -111,6 +123,52 @@ bool is_int_imm(opcode_t opcode){
         return (opcode == ADDI || opcode == SUBI);
 }
 
+/* returns true if the instruction reads the given general purpose register in the ID stage */
+bool reads_register(instruction_t instr, unsigned reg){
+        if (is_int_r(instr.opcode) || instr.opcode == SW) return (instr.src1 == reg || instr.src2 == reg);
+        if (is_int_imm(instr.opcode) || instr.opcode == LW || is_branch(instr.opcode)) return (instr.src1 == reg);
+        return false;
+}
+
+/* returns true if the instruction writes the given general purpose register in the WB stage */
+bool writes_register(instruction_t instr, unsigned reg){
+        return ((is_int_r(instr.opcode) || is_int_imm(instr.opcode) || instr.opcode == LW) && instr.dest == reg);
+}
+
+/* returns the word read by a LW at "memory" (little-endian, as written by write_memory) */
+unsigned load_word(const unsigned char *memory){
+	unsigned value;
+	memcpy(&value, memory, sizeof value);
+	return value;
+}
+
+/* returns the assembly name of the opcode */
+const char *opcode_name(opcode_t opcode){
+	return instr_names[opcode];
+}
+
+/* prints "memory" within the specified address range: the text is formatted in a buffer and written at once, leaving the state of cout untouched */
+void print_data_memory(const unsigned char *memory, unsigned start_address, unsigned end_address){
+	static const char digits[] = "0123456789abcdef";
+	string text;
+	char line[64];
+	snprintf(line, sizeof line, "data_memory[0x%08x:0x%08x]\n", start_address, end_address);
+	text.reserve((end_address - start_address) * 5 + 64);
+	text += line;
+	for (unsigned i=start_address; i<end_address; i++){
+		if (i%4 == 0){
+			snprintf(line, sizeof line, "0x%08x: ", i);
+			text += line;
+		}
+		text += digits[memory[i] >> 4];
+		text += digits[memory[i] & 0xF];
+		text += ' ';
+		if (i%4 == 3) text += '\n';
+	}
+	cout.write(text.data(), text.size());
+	cout.flush();
+}
+
 /* =============================================================
 
    CODE PROVIDED - NO NEED TO MODIFY FUNCTIONS BELOW
@@ -120,8 +178,22 @@ bool is_int_imm(opcode_t opcode){
 /* loads the assembly program in file "filename" in instruction memory at the specified address */
 void sim_pipe::load_program(const char *filename, unsigned base_address){
 
+   /* opening the assembly file */
+   ifstream fin(filename, ios::in | ios::binary);
+   if (!fin.is_open()) {
+      cerr << "error: open file " << filename << " failed!" << endl;
+      exit(-1);
+   }
+   load_program(fin, base_address);
+}
+
+/* loads the assembly program read from "program" in instruction memory at the specified address */
+void sim_pipe::load_program(istream &program, unsigned base_address){
+
    /* initializing the base instruction address */
    instr_base_address = base_address;
+   if (xlat != NULL) xlat_reset();
+   if (btc != NULL) btc_reset();
 
    /* creating a map with the valid opcodes and with the valid labels */
    map<string, opcode_t> opcodes; //for opcodes
@@ -129,29 +201,27 @@ void sim_pipe::load_program(const char *filename, unsigned base_address){
    for (int i=0; i<NUM_OPCODES; i++)
 	 opcodes[string(instr_names[i])]=(opcode_t)i;
 
-   /* opening the assembly file */
-   ifstream fin(filename, ios::in | ios::binary);
-   if (!fin.is_open()) {
-      cerr << "error: open file " << filename << " failed!" << endl;
-      exit(-1);
-   }
-
-   /* parsing the assembly file line by line */
+   /* parsing the assembly program line by line */
    string line;
    unsigned instruction_nr = 0;
-   while (getline(fin,line)){
+   while (getline(program,line)){
+	if (instruction_nr == PROGRAM_SIZE){
+		cerr << "error: the program does not fit in the instruction memory (" << PROGRAM_SIZE << " instructions)" << endl;
+		exit(-1);
+	}
 	// set the instruction field
 	char *str = const_cast<char*>(line.c_str());
+	char *save; //strtok_r: programs may be loaded by several threads at once (see sim_server.cc)
 
   	// tokenize the instruction
-	char *token = strtok (str," \t");
+	char *token = strtok_r(str, " \t", &save);
 	map<string, opcode_t>::iterator search = opcodes.find(token);
         if (search == opcodes.end()){
 		// this is a label for a branch - extract it and save it in the labels map
 		string label = string(token).substr(0, string(token).length() - 1);
 		labels[label]=instruction_nr;
                 // move to next token, which must be the instruction opcode
-		token = strtok (NULL, " \t");
+		token = strtok_r(NULL, " \t", &save);
 		search = opcodes.find(token);
 		if (search == opcodes.end()) cout << "ERROR: invalid opcode: " << token << " !" << endl;
 	}
@@ -165,35 +235,35 @@ void sim_pipe::load_program(const char *filename, unsigned base_address){
 		case ADD:
 		case SUB:
 		case XOR:
-			par1 = strtok (NULL, " \t");
-			par2 = strtok (NULL, " \t");
-			par3 = strtok (NULL, " \t");
-			instr_memory[instruction_nr].dest = atoi(strtok(par1, "R"));
-			instr_memory[instruction_nr].src1 = atoi(strtok(par2, "R"));
-			instr_memory[instruction_nr].src2 = atoi(strtok(par3, "R"));
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			par3 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].dest = atoi(strtok_r(par1, "R", &save));
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(par2, "R", &save));
+			instr_memory[instruction_nr].src2 = atoi(strtok_r(par3, "R", &save));
 			break;
 		case ADDI:
 		case SUBI:
-			par1 = strtok (NULL, " \t");
-			par2 = strtok (NULL, " \t");
-			par3 = strtok (NULL, " \t");
-			instr_memory[instruction_nr].dest = atoi(strtok(par1, "R"));
-			instr_memory[instruction_nr].src1 = atoi(strtok(par2, "R"));
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			par3 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].dest = atoi(strtok_r(par1, "R", &save));
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(par2, "R", &save));
 			instr_memory[instruction_nr].immediate = strtoul (par3, NULL, 0); 
 			break;
 		case LW:
-			par1 = strtok (NULL, " \t");
-			par2 = strtok (NULL, " \t");
-			instr_memory[instruction_nr].dest = atoi(strtok(par1, "R"));
-			instr_memory[instruction_nr].immediate = strtoul(strtok(par2, "()"), NULL, 0);
-			instr_memory[instruction_nr].src1 = atoi(strtok(NULL, "R"));
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].dest = atoi(strtok_r(par1, "R", &save));
+			instr_memory[instruction_nr].immediate = strtoul(strtok_r(par2, "()", &save), NULL, 0);
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(NULL, "R", &save));
 			break;
 		case SW:
-			par1 = strtok (NULL, " \t");
-			par2 = strtok (NULL, " \t");
-			instr_memory[instruction_nr].src2 = atoi(strtok(par1, "R"));
-			instr_memory[instruction_nr].immediate = strtoul(strtok(par2, "()"), NULL, 0);
-			instr_memory[instruction_nr].src1 = atoi(strtok(NULL, "R"));
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].src2 = atoi(strtok_r(par1, "R", &save));
+			instr_memory[instruction_nr].immediate = strtoul(strtok_r(par2, "()", &save), NULL, 0);
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(NULL, "R", &save));
 			break;
 		case BEQZ:
 		case BNEZ:
@@ -201,13 +271,13 @@ void sim_pipe::load_program(const char *filename, unsigned base_address){
 		case BGTZ:
 		case BLEZ:
 		case BGEZ:
-			par1 = strtok (NULL, " \t");
-			par2 = strtok (NULL, " \t");
-			instr_memory[instruction_nr].src1 = atoi(strtok(par1, "R"));
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(par1, "R", &save));
 			instr_memory[instruction_nr].label = par2;
 			break;
 		case JUMP:
-			par2 = strtok (NULL, " \t");
+			par2 = strtok_r(NULL, " \t", &save);
 			instr_memory[instruction_nr].label = par2;
 		default:
 			break;
@@ -219,7 +289,7 @@ void sim_pipe::load_program(const char *filename, unsigned base_address){
    }
    //reconstructing the labels of the branch operations
    int i = 0;
-   while(true){
+   while(i < PROGRAM_SIZE){
    	instruction_t instr = instr_memory[i];
 	if (instr.opcode == EOP) break;
 	if (instr.opcode == BLTZ || instr.opcode == BNEZ ||
@@ -231,6 +301,13 @@ void sim_pipe::load_program(const char *filename, unsigned base_address){
 	}
         i++;
    }
+   //list scheduling within the basic blocks (the branch immediates are resolved again on the scheduled code)
+   if (sched != NULL){
+	bool leader[PROGRAM_SIZE] = {false};
+	for (map<string, unsigned>::iterator l = labels.begin(); l != labels.end(); l++)
+		if (l->second < PROGRAM_SIZE) leader[l->second] = true;
+	schedule_program(leader);
+   }
 
 }
 
@@ -241,12 +318,9 @@ void sim_pipe::write_memory(unsigned address, unsigned value){
 
 /* prints the content of the data memory within the specified address range */
 void sim_pipe::print_memory(unsigned start_address, unsigned end_address){
-	cout << "data_memory[0x" << hex << setw(8) << setfill('0') << start_address << ":0x" << hex << setw(8) << setfill('0') <<  end_address << "]" << endl;
-	for (unsigned i=start_address; i<end_address; i++){
-		if (i%4 == 0) cout << "0x" << hex << setw(8) << setfill('0') << i << ": "; 
-		cout << hex << setw(2) << setfill('0') << int(data_memory[i]) << " ";
-		if (i%4 == 3) cout << endl;
-	} 
+	print_data_memory(data_memory, start_address, end_address);
+	// as in the original formatting with iostream manipulators, cout is left in hexadecimal with '0' fill
+	cout << hex << setfill('0');
 }
 
 /* prints the values of the registers */
@@ -267,13 +341,53 @@ void sim_pipe::print_registers(){
 sim_pipe::sim_pipe(unsigned mem_size, unsigned mem_latency){
 	data_memory_size = mem_size;
 	data_memory_latency = mem_latency;
-	data_memory = new unsigned char[data_memory_size];
+	allocate_data_memory();
+	num_mshrs = 0;
+	mshrs = NULL;
+	store_buffer_size = 0;
+	store_buffer = NULL;
+	default_backend = new fixed_latency_backend(data_memory_latency);
+	backend = default_backend;
+	data_prefetcher = NULL;
+	prefetch_buffer = NULL;
+	prefetch_buffer_size = 0;
+	ooo = NULL;
+	loop = NULL;
+	deep = NULL;
+	icache = NULL;
+	mmio = NULL;
+	check = NULL;
+	mem_trace = NULL;
+	xlat = NULL;
+	intervals = NULL;
+	energy = NULL;
+	limit_study = NULL;
+	sched = NULL;
+	btc = NULL;
 	reset();
 }
 	
 /* deallocates the pipeline simulator */
 sim_pipe::~sim_pipe(){
-	delete [] data_memory;
+	release_data_memory();
+	delete [] mshrs;
+	delete [] store_buffer;
+	delete default_backend;
+	delete [] prefetch_buffer;
+	set_ooo_window(0, 0);
+	set_loop_acceleration(false);
+	set_pipeline_depth(0, 0, 0);
+	set_icache(0, 0, 0, 0);
+	delete mmio;
+	set_lockstep_check(false);
+	set_mem_trace(NULL);
+	if (xlat != NULL) xlat_reset();
+	delete xlat;
+	delete intervals;
+	set_energy_model(NULL);
+	set_limit_study(false);
+	set_scheduling(false);
+	set_block_timing(false);
 	//delete [] instr_ptr;
 }
 
@@ -286,6 +400,33 @@ unsigned sim_pipe::get_instructions_executed(){return instructions_executed;}
 unsigned sim_pipe::get_stalls(){return stalls;}
 
 float sim_pipe::get_IPC(){return (float)instructions_executed/clock_cycles;}
+
+unsigned sim_pipe::get_scoreboard_stalls(){return scoreboard_stalls;}
+
+unsigned sim_pipe::get_mshr_full_stalls(){return mshr_full_stalls;}
+
+unsigned sim_pipe::get_store_buffer_stalls(){return sb_full_stalls;}
+
+unsigned sim_pipe::get_store_buffer_forwards(){return sb_forwards;}
+
+unsigned sim_pipe::get_store_buffer_coalesced(){return sb_coalesced;}
+
+float sim_pipe::get_store_buffer_occupancy(){return clock_cycles ? (float)sb_occupancy/clock_cycles : 0;}
+
+unsigned sim_pipe::get_store_buffer_peak(){return sb_peak;}
+
+unsigned sim_pipe::get_prefetches_issued(){return prefetches_issued;}
+
+unsigned sim_pipe::get_prefetches_useful(){return prefetches_useful;}
+
+unsigned sim_pipe::get_prefetches_late(){return prefetches_late;}
+
+void sim_pipe::print_prefetch_stats(){
+	cout << "Prefetches issued: " << dec << prefetches_issued << endl;
+	cout << "Accuracy: " << (prefetches_issued ? (float)prefetches_useful/prefetches_issued : 0) << endl;
+	cout << "Coverage: " << (prefetch_demand_loads ? (float)prefetch_demand_hits/prefetch_demand_loads : 0) << endl;
+	cout << "Timeliness: " << (prefetches_useful ? (float)(prefetches_useful-prefetches_late)/prefetches_useful : 0) << endl;
+}
                                 
 /* =============================================================
 
@@ -359,6 +500,79 @@ void sim_pipe::reset(){
 	//	structural_mem_hazard_propagate_3=0;
 		mem_hazard_pipe_freeze=0;
 		latency_tracker=0;
+		access_latency=data_memory_latency;
+
+	// timing state of the data memory model
+	backend->reset();
+	scheduled_latency=0;
+
+	// non-blocking memory stage (the number of MSHRs is configuration and is preserved)
+	for (unsigned i=0; i<num_mshrs; i++) mshrs[i].valid=0;
+	for (int i=0; i<NUM_GP_REGISTERS; i++) scoreboard[i]=0;
+	deferred_load_wb=0;
+	scoreboard_stalls=0;
+	mshr_full_stalls=0;
+
+	// store buffer (the number of entries is configuration and is preserved)
+	sb_head=0;
+	sb_count=0;
+	sb_drain_ready=UNDEFINED;
+	load_forwarded=0;
+	sb_full_stalls=0;
+	sb_forwards=0;
+	sb_coalesced=0;
+	sb_peak=0;
+	sb_occupancy=0;
+
+	// data prefetcher
+	if (data_prefetcher != NULL) data_prefetcher->reset();
+	for (unsigned i=0; i<prefetch_buffer_size; i++) prefetch_buffer[i].line=UNDEFINED;
+	prefetch_fills=0;
+	prefetches_issued=0;
+	prefetches_useful=0;
+	prefetches_late=0;
+	prefetch_demand_loads=0;
+	prefetch_demand_hits=0;
+
+	// out-of-order core
+	if (ooo != NULL) ooo_reset();
+
+	// loop acceleration (enabled or not is configuration and is preserved)
+	if (loop != NULL) loop_reset();
+
+	// pipeline of configurable depth (the depth is configuration and is preserved)
+	if (deep != NULL) deep_reset();
+
+	// instruction cache (the geometry is configuration and is preserved)
+	if (icache != NULL) icache_reset();
+
+	// devices (the mapping is configuration and is preserved) and pending events
+	skipped_cycles=0;
+	if (mmio != NULL)
+	{
+		mmio->scheduler.clear();
+		for (unsigned i=0; i<mmio->ranges.size(); i++) mmio->ranges[i].device->reset();
+	}
+	if (check != NULL) check_reset();
+
+	// translated blocks (of the program cleared above)
+	if (xlat != NULL) xlat_reset();
+
+	// results of the interval simulation
+	delete intervals;
+	intervals = NULL;
+
+	// energy model (the table is configuration and is preserved)
+	if (energy != NULL) energy_reset();
+
+	// dependence graph of the limit study
+	if (limit_study != NULL) limit_reset();
+
+	// scheduling statistics (of the program cleared above)
+	if (sched != NULL) sched_reset();
+
+	// timed blocks (of the program cleared above)
+	if (btc != NULL) btc_reset();
 }
 
 //returns value of special purpose register (see sim_pipe.h for more details)
@@ -366,7 +580,7 @@ unsigned sim_pipe::get_sp_register(sp_register_t reg, stage_t s)
 {
 	if (reg==PC && s==IF && clock_cycles==0)
 	{
-		return instr_base_address;  //before simulator is run return instruction base address
+		return start_pc();  //before simulator is run return instruction base address (or the next instruction of run_translated)
 	}
 
 	if(reg==PC && s==IF && structural_mem_hazard==1 && raw_hazard==0)
@@ -395,6 +609,379 @@ void sim_pipe::set_gp_register(unsigned reg, int value)
 	
 }
 
+/* selects the timing model of the data memory */
+void sim_pipe::set_mem_backend(mem_backend *b){
+	backend = (b != NULL) ? b : default_backend;
+	backend->reset();
+}
+
+/* maps a device in the address space of the LW/SW */
+void sim_pipe::attach_device(mmio_device *device, unsigned base_address, unsigned size){
+	if (mmio == NULL) mmio = new mmio_state_t;
+	for (unsigned i=0; i<mmio->ranges.size(); i++){
+		mmio_range_t *r = &mmio->ranges[i];
+		if (base_address < r->base + r->size && r->base < base_address + size){
+			cerr << "error: device range 0x" << hex << base_address << "-0x" << base_address + size << dec << " overlaps another device" << endl;
+			exit(-1);
+		}
+	}
+	mmio_range_t r;
+	r.base = base_address;
+	r.size = size;
+	r.device = device;
+	mmio->ranges.push_back(r);
+	device->attach(&mmio->scheduler, data_memory, data_memory_size);
+	device->reset();
+}
+
+/* returns the device mapped at "address" (and the offset of the address in its range), NULL if none */
+mmio_device *sim_pipe::find_device(unsigned address, unsigned *offset){
+	if (mmio == NULL) return NULL;
+	for (unsigned i=0; i<mmio->ranges.size(); i++){
+		mmio_range_t *r = &mmio->ranges[i];
+		if (address >= r->base && address - r->base < r->size){
+			*offset = address - r->base;
+			return r->device;
+		}
+	}
+	return NULL;
+}
+
+unsigned sim_pipe::get_skipped_cycles(){return skipped_cycles;}
+
+/* attaches the data prefetcher */
+void sim_pipe::set_prefetcher(prefetcher *p, unsigned buffer_lines){
+	delete [] prefetch_buffer;
+	data_prefetcher = p;
+	prefetch_buffer_size = (p != NULL) ? buffer_lines : 0;
+	prefetch_buffer = (prefetch_buffer_size > 0) ? new prefetch_entry_t[prefetch_buffer_size] : NULL;
+	for (unsigned i=0; i<prefetch_buffer_size; i++) prefetch_buffer[i].line=UNDEFINED;
+	if (p != NULL) p->reset();
+}
+
+/* trains the prefetcher with a demand access and brings the requested lines into the prefetch buffer */
+void sim_pipe::prefetch_train(unsigned pc, unsigned address, bool write, unsigned cycle){
+	unsigned requests[16];
+	unsigned n = data_prefetcher->observe(pc, address, write, requests, 16);
+	for (unsigned r=0; r<n; r++){
+		if (requests[r] >= data_memory_size) continue;
+		int present = 0;
+		prefetch_entry_t *victim = &prefetch_buffer[0];
+		for (unsigned i=0; i<prefetch_buffer_size && !present; i++){
+			if (prefetch_buffer[i].line == requests[r]) present = 1;
+			else if (prefetch_buffer[i].line == UNDEFINED || (victim->line != UNDEFINED && prefetch_buffer[i].fill < victim->fill)) victim = &prefetch_buffer[i];
+		}
+		if (present) continue;
+		victim->line = requests[r];
+		victim->ready_cycle = cycle + backend->access(requests[r], false, cycle);
+		victim->used = 0;
+		victim->fill = prefetch_fills++;
+		prefetches_issued++;
+	}
+}
+
+/* returns the latency of a demand access issued at "cycle": a load hitting a prefetched line only waits for the line to arrive */
+unsigned sim_pipe::demand_latency(opcode_t opcode, unsigned address, unsigned cycle){
+	if (data_prefetcher != NULL && opcode == LW){
+		unsigned line = address - address % data_prefetcher->get_line_size();
+		prefetch_demand_loads++;
+		for (unsigned i=0; i<prefetch_buffer_size; i++){
+			prefetch_entry_t *e = &prefetch_buffer[i];
+			if (e->line != line) continue;
+			prefetch_demand_hits++;
+			if (!e->used){
+				e->used = 1;
+				prefetches_useful++;
+				if (e->ready_cycle > cycle) prefetches_late++;
+			}
+			return (e->ready_cycle > cycle) ? e->ready_cycle - cycle : 0;
+		}
+	}
+	return backend->access(address, opcode==SW, cycle);
+}
+
+/* configures the non-blocking memory stage */
+void sim_pipe::set_mshrs(unsigned n){
+	delete [] mshrs;
+	num_mshrs = n;
+	mshrs = (n > 0) ? new mshr_t[n] : NULL;
+	for (unsigned i=0; i<num_mshrs; i++) mshrs[i].valid=0;
+	for (int i=0; i<NUM_GP_REGISTERS; i++) scoreboard[i]=0;
+}
+
+/* returns the number of cycles the memory instruction entering the MEM stage in the next cycle has to wait for a free MSHR */
+unsigned sim_pipe::mshr_wait(){
+	unsigned first_free = UNDEFINED;
+	for (unsigned i=0; i<num_mshrs; i++){
+		if (!mshrs[i].valid || mshrs[i].ready_cycle <= clock_cycles+1) return 0;
+		if (mshrs[i].ready_cycle < first_free) first_free = mshrs[i].ready_cycle;
+	}
+	return first_free - (clock_cycles+1);
+}
+
+/* books a MSHR for an access leaving the MEM stage in the current cycle */
+void sim_pipe::mshr_allocate(opcode_t opcode, unsigned dest, unsigned address, unsigned data){
+	for (unsigned i=0; i<num_mshrs; i++){
+		if (mshrs[i].valid) continue;
+		mshrs[i].valid = 1;
+		mshrs[i].opcode = opcode;
+		mshrs[i].dest = dest;
+		mshrs[i].address = address;
+		mshrs[i].data = data;
+		mshrs[i].issue_cycle = clock_cycles;
+		// same write-back cycle as a blocking access of the same latency
+		mshrs[i].ready_cycle = clock_cycles + scheduled_latency + 1;
+		if (opcode == LW) scoreboard[dest]++;
+		return;
+	}
+	cerr << "error: no free MSHR at cycle " << dec << clock_cycles << endl;
+	exit(-1);
+}
+
+/* retires the accesses completing at the beginning of the current cycle: loads write back their destination register */
+void sim_pipe::mshr_complete(){
+	for (unsigned i=0; i<num_mshrs; i++){
+		if (!mshrs[i].valid || mshrs[i].ready_cycle > clock_cycles) continue;
+		if (mshrs[i].opcode == LW){
+			set_gp_register(mshrs[i].dest, mshrs[i].data);
+			scoreboard[mshrs[i].dest]--;
+		}
+		mshrs[i].valid = 0;
+	}
+}
+
+/* returns the number of outstanding accesses */
+unsigned sim_pipe::mshr_outstanding(){
+	unsigned n = 0;
+	for (unsigned i=0; i<num_mshrs; i++) if (mshrs[i].valid) n++;
+	return n;
+}
+
+/* returns true if the instruction reads or writes a register that an outstanding load has not written back yet */
+/* loads that left the MEM stage in this cycle are still in the MEM/WB latch and are covered by the regular RAW checks */
+int sim_pipe::pending_load_hazard(instruction_t instr){
+	for (unsigned i=0; i<num_mshrs; i++){
+		if (!mshrs[i].valid || mshrs[i].opcode != LW) continue;
+		if (writes_register(instr, mshrs[i].dest)) return 1;
+		if (mshrs[i].issue_cycle != clock_cycles && reads_register(instr, mshrs[i].dest)) return 1;
+	}
+	return 0;
+}
+
+/* decides how the memory instruction entering the MEM stage in the next cycle accesses the data memory */
+/* if it has to wait, the pipeline is frozen for "access_latency" cycles through the structural hazard */
+void sim_pipe::schedule_memory_access(opcode_t opcode, unsigned address, unsigned pc){
+	unsigned wait = 0;
+	unsigned offset;
+	mmio_device *device = find_device(address, &offset);
+	load_forwarded = 0;
+	if (device != NULL)
+	{
+		// device access: uncached and blocking
+		wait = device->get_latency();
+	}
+	else if (opcode==SW && store_buffer_size>0)
+	{
+		// buffered store: waits only for a free entry
+		wait = store_buffer_wait(address);
+		sb_full_stalls += wait;
+	}
+	else if (opcode==LW && store_buffer_size>0 && store_buffer_read(address, NULL) && store_buffer_read(address+1, NULL) && store_buffer_read(address+2, NULL) && store_buffer_read(address+3, NULL))
+	{
+		// load forwarded from the store buffer (all its bytes are buffered): no data memory access
+		load_forwarded = 1;
+		sb_forwards++;
+	}
+	else if (num_mshrs>0)
+	{
+		// non-blocking memory stage: the pipeline freezes only while all the MSHRs are busy
+		wait = mshr_wait();
+		mshr_full_stalls += wait;
+		scheduled_latency = demand_latency(opcode, address, clock_cycles+1+wait);
+	}
+	else
+	{
+		wait = demand_latency(opcode, address, clock_cycles+1);
+	}
+	// the prefetcher observes every access entering the MEM stage
+	if (data_prefetcher != NULL && device == NULL) prefetch_train(pc, address, opcode==SW, clock_cycles+1);
+	if (mem_trace != NULL) trace_access(opcode, address, pc);
+	if (wait>0)
+	{
+		structural_mem_hazard=1;
+		latency_tracker=0;
+		access_latency=wait;
+	}
+}
+
+/* performs the data memory access of the instruction leaving the MEM stage */
+void sim_pipe::memory_access(){
+	ir[MEM]=ir[EXE];
+	deferred_load_wb=0;
+	if (check != NULL && ir[EXE].opcode==SW) check_store(sp_registers[ALU_OUTPUT][MEM], sp_registers[B][MEM]);
+	if (device_access()) return;
+	if(ir[EXE].opcode==SW)
+	{
+		if (store_buffer_size>0)
+		{
+			store_buffer_insert(sp_registers[ALU_OUTPUT][MEM], sp_registers[B][MEM]);
+		}
+		else
+		{
+			write_memory(sp_registers[ALU_OUTPUT][MEM], sp_registers[B][MEM]);
+			if (num_mshrs>0) mshr_allocate(SW, UNDEFINED, sp_registers[ALU_OUTPUT][MEM], sp_registers[B][MEM]);
+		}
+		sp_registers[LMD][WB]=UNDEFINED;
+		sp_registers[ALU_OUTPUT][WB]=sp_registers[ALU_OUTPUT][MEM];
+	}
+	if(ir[EXE].opcode==LW)
+	{
+		// the buffered bytes are younger than the data memory ones
+		unsigned char value[4];
+		for (unsigned i=0; i<4; i++)
+			if (store_buffer_size==0 || !store_buffer_read(sp_registers[ALU_OUTPUT][MEM]+i, &value[i])) value[i]=data_memory[sp_registers[ALU_OUTPUT][MEM]+i];
+		sp_registers[LMD][WB]=load_word(value);
+		sp_registers[ALU_OUTPUT][WB]=sp_registers[ALU_OUTPUT][MEM];
+		if (num_mshrs>0 && !load_forwarded)
+		{
+			mshr_allocate(LW, ir[EXE].dest, sp_registers[ALU_OUTPUT][MEM], sp_registers[LMD][WB]);
+			deferred_load_wb=1;
+		}
+	}
+}
+
+/* performs the access of the instruction leaving the MEM stage if it targets a device; returns 0 otherwise */
+int sim_pipe::device_access(){
+	unsigned offset;
+	mmio_device *device = find_device(sp_registers[ALU_OUTPUT][MEM], &offset);
+	if (device == NULL) return 0;
+	if(ir[EXE].opcode==SW)
+	{
+		device->write(offset, sp_registers[B][MEM], clock_cycles);
+		sp_registers[LMD][WB]=UNDEFINED;
+	}
+	else
+	{
+		sp_registers[LMD][WB]=device->read(offset - offset%4, clock_cycles);
+	}
+	sp_registers[ALU_OUTPUT][WB]=sp_registers[ALU_OUTPUT][MEM];
+	return 1;
+}
+
+/* configures the store buffer */
+void sim_pipe::set_store_buffer(unsigned entries){
+	if (entries==1){
+		cerr << "error: the store buffer needs at least 2 entries" << endl;
+		exit(-1);
+	}
+	delete [] store_buffer;
+	store_buffer_size = entries;
+	store_buffer = (entries > 0) ? new store_buffer_entry_t[entries] : NULL;
+	sb_head = 0;
+	sb_count = 0;
+	sb_drain_ready = UNDEFINED;
+}
+
+/* returns the youngest entry holding the given block, or -1 if the block is not buffered */
+int sim_pipe::store_buffer_find(unsigned block){
+	for (int i=sb_count-1; i>=0; i--){
+		unsigned e = (sb_head + i) % store_buffer_size;
+		if (store_buffer[e].block == block) return e;
+	}
+	return -1;
+}
+
+/* returns the number of cycles a SW entering the MEM stage in the next cycle has to wait for free store buffer entries */
+unsigned sim_pipe::store_buffer_wait(unsigned address){
+	unsigned first = address - address % STORE_BUFFER_BLOCK;
+	unsigned last = (address + 3) - (address + 3) % STORE_BUFFER_BLOCK;
+	// a store cannot coalesce into the head entry, which is being drained: after "retired" entries have left the buffer,
+	// the head is the entry "retired" positions after the current one, which raises the entries needed (at most once per block)
+	unsigned retired = 0;
+	while (1){
+		unsigned needed = 0;
+		for (unsigned block = first; ; block += STORE_BUFFER_BLOCK){
+			int e = store_buffer_find(block);
+			if (e < 0 || (e + store_buffer_size - sb_head) % store_buffer_size <= retired) needed++;
+			if (block == last) break;
+		}
+		if (sb_count + needed <= store_buffer_size + retired) break;
+		retired = sb_count + needed - store_buffer_size;
+	}
+	if (retired == 0) return 0;
+	// entries drain one at a time, starting with the head: only the head drain time is known, the following ones are estimated
+	unsigned drain_latency = (data_memory_latency > 0) ? data_memory_latency : 1;
+	unsigned ready = sb_drain_ready + (retired - 1) * drain_latency;
+	return (ready > clock_cycles + 1) ? ready - (clock_cycles + 1) : 0;
+}
+
+/* starts draining the head entry at the given cycle */
+void sim_pipe::store_buffer_start_drain(unsigned cycle){
+	unsigned latency = backend->access(store_buffer[sb_head].block, true, cycle);
+	sb_drain_ready = cycle + ((latency > 0) ? latency : 1);
+}
+
+/* writes the head entry to the data memory and removes it from the buffer */
+void sim_pipe::store_buffer_retire_head(){
+	store_buffer_entry_t *entry = &store_buffer[sb_head];
+	for (unsigned i=0; i<STORE_BUFFER_BLOCK; i++)
+		if (entry->mask[i] && entry->block + i < data_memory_size) data_memory[entry->block + i] = entry->data[i];
+	sb_head = (sb_head + 1) % store_buffer_size;
+	sb_count--;
+	sb_drain_ready = UNDEFINED;
+}
+
+/* buffers the 4 bytes written by a SW leaving the MEM stage (little-endian, as write_memory) */
+void sim_pipe::store_buffer_insert(unsigned address, unsigned value){
+	unsigned char buffer[4];
+	int2char(value, buffer);
+	int e = -1;
+	for (unsigned i=0; i<4; i++){
+		unsigned block = (address + i) - (address + i) % STORE_BUFFER_BLOCK;
+		// the first byte of the store in a block picks the entry, the following ones go to the same entry
+		if (i == 0 || (address + i) % STORE_BUFFER_BLOCK == 0){
+			e = store_buffer_find(block);
+			// a store cannot coalesce into the head entry, which is being drained
+			if (e >= 0 && (unsigned)e != sb_head) sb_coalesced++;
+			else {
+				// the wait of a store needing two entries is estimated: if it was short, the head is written back early
+				if (sb_count == store_buffer_size){
+					store_buffer_retire_head();
+					if (sb_count > 0) store_buffer_start_drain(clock_cycles + 1);
+				}
+				e = (sb_head + sb_count) % store_buffer_size;
+				sb_count++;
+				store_buffer[e].block = block;
+				memset(store_buffer[e].mask, 0, STORE_BUFFER_BLOCK);
+				if (sb_count == 1) store_buffer_start_drain(clock_cycles + 1);
+			}
+		}
+		store_buffer[e].data[(address + i) - block] = buffer[i];
+		store_buffer[e].mask[(address + i) - block] = 1;
+	}
+	if (sb_count > sb_peak) sb_peak = sb_count;
+}
+
+/* looks up a byte in the store buffer (youngest store first); returns 1 on a hit and copies the byte to "value" if not NULL */
+int sim_pipe::store_buffer_read(unsigned address, unsigned char *value){
+	unsigned block = address - address % STORE_BUFFER_BLOCK;
+	for (int i=sb_count-1; i>=0; i--){
+		unsigned e = (sb_head + i) % store_buffer_size;
+		if (store_buffer[e].block != block || !store_buffer[e].mask[address - block]) continue;
+		if (value != NULL) *value = store_buffer[e].data[address - block];
+		return 1;
+	}
+	return 0;
+}
+
+/* writes the head entry to the data memory once its drain completes, then starts draining the next one */
+void sim_pipe::store_buffer_drain(){
+	sb_occupancy += sb_count;
+	if (sb_count == 0 || clock_cycles < sb_drain_ready) return;
+	store_buffer_retire_head();
+	if (sb_count > 0) store_buffer_start_drain(clock_cycles);
+}
+
 /* <TODO: BODY OF THE SIMULATOR */
 // Note: processing the stages in reverse order simplifies the data propagation through pipeline registers
 void sim_pipe::run(unsigned cycles){
@@ -403,9 +990,14 @@ void sim_pipe::run(unsigned cycles){
 	/* initialization at the beginning of simulation */
 	if (clock_cycles == 0)
 	{
-		// <set PC register to instr_base_address>
-		sp_registers[PC][IF]=instr_base_address;
+		// <set PC register to instr_base_address> (or to the next instruction of run_translated)
+		sp_registers[PC][IF]=start_pc();
+
+		// the original program of a scheduled one is simulated first, from the same initial state
+		if (sched != NULL && sched->measure) schedule_reference();
 
+		// the lockstep check starts from the initial architectural state
+		if (check != NULL) check_start();
 	}
 
 	/* ====== MAIN SIMULATION LOOP (one iteration per clock cycle)  ========= */
@@ -415,7 +1007,52 @@ void sim_pipe::run(unsigned cycles){
                 /* PIPELINE STAGES */
                 /* =============== */
 
+		/* outstanding non-blocking accesses completing in this cycle */
+		if (num_mshrs>0) mshr_complete();
+		if (store_buffer_size>0) store_buffer_drain();
+
+		/* device events of this cycle */
+		if (mmio != NULL) mmio->scheduler.fire(clock_cycles);
+
+		/* idle cycles: while the frozen memory stage only counts down the latency of its access, nothing else changes */
+		/* state until its last frozen cycle: jump ahead, stopping at the next device event */
+		if (structural_mem_hazard==1 && ir[MEM].opcode==NOP && latency_tracker>=1 && latency_tracker+1<access_latency && num_mshrs==0 && store_buffer_size==0 && icache==NULL)
+		{
+			unsigned skip = access_latency-1-latency_tracker;
+			unsigned next_event = (mmio != NULL) ? mmio->scheduler.next_event() : UNDEFINED;
+			if (next_event != UNDEFINED && next_event-clock_cycles < skip) skip = next_event-clock_cycles;
+			if (cycles!=0 && start_cycles+cycles-clock_cycles < skip) skip = start_cycles+cycles-clock_cycles;
+			if (skip>0)
+			{
+				latency_tracker += skip;
+				stalls += skip;
+				clock_cycles += skip;
+				skipped_cycles += skip;
+				if (limit_study != NULL) limit_study->memory_stall_cycles += skip;
+				continue;
+			}
+		}
+
+		/* steady-state loop iterations skipped at the write back of a taken backward branch */
+		if (loop != NULL)
+		{
+			loop_boundary(cycles==0 ? UNDEFINED : start_cycles+cycles);
+			loop_commit();
+		}
+
+		/* basic blocks replayed from the timing cache at the write back of a branch */
+		if (btc != NULL) btc_boundary(cycles==0 ? UNDEFINED : start_cycles+cycles);
+
+		/* activity of the instruction written back in this cycle */
+		if (energy != NULL) energy_commit();
+
+		/* dependences of the instruction written back in this cycle */
+		if (limit_study != NULL) limit_commit();
+
 		/* ============   WB stage   ============  */
+
+		// lockstep check of the instruction written back: the simulation stops at the first divergence
+		if (check != NULL && ir[MEM].opcode != NOP && !check_retire()) break;
 		
 		
 
@@ -437,19 +1074,9 @@ void sim_pipe::run(unsigned cycles){
 
 		if(is_memory(ir[MEM].opcode))
 		{
-			if(ir[MEM].opcode==LW)
+			if(ir[MEM].opcode==LW && deferred_load_wb==0)
 			{
-				if(sp_registers[LMD][WB]>127)
-				{
-
-					set_gp_register(ir[MEM].dest , (sp_registers[LMD][WB]-256));
-				}
-				if(sp_registers[LMD][WB]<=127)
-				{
-
-					set_gp_register(ir[MEM].dest , sp_registers[LMD][WB]);
-				}
-
+				set_gp_register(ir[MEM].dest, sp_registers[LMD][WB]);
 			}
 			instructions_executed++;
 		}
@@ -461,7 +1088,9 @@ void sim_pipe::run(unsigned cycles){
 
 		if(ir[MEM].opcode == EOP)
 		{
-			break;
+			if ((num_mshrs==0 || mshr_outstanding()==0) && sb_count==0) break;
+			stalls++; //draining the outstanding loads and the buffered stores
+			if (limit_study != NULL) limit_study->memory_stall_cycles++;
 		}
 
 		
@@ -491,23 +1120,12 @@ void sim_pipe::run(unsigned cycles){
 			if(structural_mem_hazard==0)
 			{
 				//struct_mem_hazard=0;
-				ir[MEM]=ir[EXE];
-				if(ir[EXE].opcode==SW)
-				{
-					write_memory(sp_registers[ALU_OUTPUT][MEM], sp_registers[B][MEM]);
-					sp_registers[LMD][WB]=UNDEFINED;
-					sp_registers[ALU_OUTPUT][WB]=sp_registers[ALU_OUTPUT][MEM];
-				}
-				if(ir[EXE].opcode==LW)
-				{
-					sp_registers[LMD][WB]=data_memory[sp_registers[ALU_OUTPUT][MEM]];
-					sp_registers[ALU_OUTPUT][WB]=sp_registers[ALU_OUTPUT][MEM];
-				}
+				memory_access();
 			}
 			if(structural_mem_hazard==1)
 			{
 				latency_tracker++;
-				if(latency_tracker <= data_memory_latency)
+				if(latency_tracker <= access_latency)
 				{
 					ir[MEM].opcode=NOP;
 					sp_registers[ALU_OUTPUT][WB]=UNDEFINED;
@@ -517,25 +1135,15 @@ void sim_pipe::run(unsigned cycles){
 				//	cout << " Latency_tracker " << latency_tracker << endl;
 				//	cout << " Data memory Latency " <<  data_memory_latency << endl;
 					stalls++;
+					if (limit_study != NULL) limit_study->memory_stall_cycles++;
 				}
-				if(latency_tracker>data_memory_latency)
+				if(latency_tracker>access_latency)
 				{
 					mem_hazard_pipe_freeze=0;
 					latency_tracker=0;
 					structural_mem_hazard=0;
-					ir[MEM]=ir[EXE];
 				//	cout << " Latency tracker >= data memory latency " << endl;
-					if(ir[EXE].opcode==SW)
-					{
-						write_memory(sp_registers[ALU_OUTPUT][MEM], sp_registers[B][MEM]);
-						sp_registers[LMD][WB]=UNDEFINED;
-						sp_registers[ALU_OUTPUT][WB]=sp_registers[ALU_OUTPUT][MEM];
-					}
-					if(ir[EXE].opcode==LW)
-					{
-						sp_registers[LMD][WB]=data_memory[sp_registers[ALU_OUTPUT][MEM]];
-						sp_registers[ALU_OUTPUT][WB]=sp_registers[ALU_OUTPUT][MEM];
-					}
+					memory_access();
 				}
 				//latency_tracker++;
 			}
@@ -627,10 +1235,9 @@ void sim_pipe::run(unsigned cycles){
 
 			if (is_memory(ir[ID].opcode))
 			{
-				if (data_memory_latency>0)
-				{structural_mem_hazard=1;}
 //				cout << " in memory ir[ID].opcode check and assign to ir[EXE] " << endl;
 				sp_registers[ALU_OUTPUT][MEM]=alu(ir[ID].opcode, sp_registers[A][EXE], sp_registers[B][EXE], sp_registers[IMM][EXE], sp_registers[NPC][EXE]);
+				schedule_memory_access(ir[ID].opcode, sp_registers[ALU_OUTPUT][MEM], sp_registers[NPC][EXE]-4);
 				ir[EXE]=ir[ID];
 				sp_registers[B][MEM]=sp_registers[B][EXE];
 				sp_registers[COND][MEM]=UNDEFINED;
@@ -712,9 +1319,17 @@ void sim_pipe::run(unsigned cycles){
 			// <suggestion: use "alu" and "taken_branch" helper functions above to update ALU_OUTPUT and COND registers>
 
 		/* ============   ID stage   ============  */
+		unsigned id_stalls = stalls; //the stalls counted by the ID stage are RAW hazards
 		if(mem_hazard_pipe_freeze==0)
 		{
 //			cout << " ID stage running " << endl;
+			// scoreboard check: wait for the outstanding loads the instruction depends on (RAW) or would overwrite (WAW)
+			if(num_mshrs>0 && pending_load_hazard(ir[IF]))
+			{
+				raw_hazard=1;
+				scoreboard_stalls++;
+				if(!reads_register(ir[IF], ir[EXE].dest) && !reads_register(ir[IF], ir[MEM].dest)) stalls++;
+			}
 			if(is_int_r(ir[IF].opcode))
 			{
 				if(ir[IF].src1==ir[EXE].dest || ir[IF].src2==ir[EXE].dest ) // check for data hazard on both source 1 and 2 registers
@@ -954,6 +1569,7 @@ void sim_pipe::run(unsigned cycles){
 
 	
 		}
+		if (limit_study != NULL && stalls != id_stalls) limit_study->raw_stall_cycles++;
 //		cout <<" Instruction at the end of ID stage opcode=> "<<ir[ID].opcode<< " A: "<< dec << sp_registers[A][EXE] << " B: " << dec << sp_registers[B][EXE] << " Imm: 0x" << hex  <<sp_registers[IMM][EXE] << " ir[ID].src1= " << ir[ID].src1 << " ir[ID].src2= " << ir[ID].src2 << " ir[ID].dest= " << ir[ID].dest << " ir[EXE].dest= "<< ir[EXE].dest << " ir[MEM].dest = " << ir[MEM].dest <<endl;
 	
 		
@@ -971,7 +1587,16 @@ void sim_pipe::run(unsigned cycles){
 				if (control_hazard==0)
 				{
 
-					if (sp_registers[COND][WB]==0)
+					// instruction cache: the fetch waits for the line of the next instruction (the branch target if a branch is taken)
+					if (icache != NULL && icache_wait(sp_registers[COND][WB]==0 ? sp_registers[ALU_OUTPUT][WB] : sp_registers[PC][IF]))
+					{
+						if (sp_registers[COND][WB]==0) sp_registers[PC][IF]=sp_registers[ALU_OUTPUT][WB];
+						icache_bubble();
+						stalls++;
+						icache->fetch_stalls++;
+					}
+
+					else if (sp_registers[COND][WB]==0)
 					{
 					
 //						cout << " Branch Taken code end of IF " << " sp_res condition " << sp_registers[COND][WB] <<endl;
@@ -1016,6 +1641,7 @@ void sim_pipe::run(unsigned cycles){
 					control_hazard_propagate=1;
 					stalls++;
 					cstalls++;
+					if (limit_study != NULL) limit_study->control_stall_cycles++;
 			//		cout << " Control Hazard =1 code " <<endl;
 //				cout << " IF stage control hazard check " << endl;
 //			       cout << " Stalls due to control Hazard " << dec << cstalls << endl;	
@@ -1036,7 +1662,35 @@ void sim_pipe::run(unsigned cycles){
 				ir[IF]=ir[IF];
 //				cout << " end of IF stage where struct and raw hazard is detected" << endl;
 			}
-			if(raw_hazard==0)
+			if(raw_hazard==0 && control_hazard==1)
+			{
+				// a branch entered the ID stage in the cycle the pipeline froze: the IF/ID latch gets its first bubble
+				// (as when not frozen), and nothing is fetched until the branch is resolved
+				if(ir[IF].opcode!=NOP)
+				{
+					ir[IF].opcode=NOP;
+					ir[IF].src1=UNDEFINED;
+					ir[IF].src2=UNDEFINED;
+					ir[IF].dest=UNDEFINED;
+					ir[IF].immediate=UNDEFINED;
+					sp_registers[NPC][ID]=UNDEFINED;
+					control_hazard_propagate=1;
+					stalls++;
+					cstalls++;
+					if (limit_study != NULL) limit_study->control_stall_cycles++;
+				}
+			}
+			else if(raw_hazard==0 && icache != NULL && icache_wait(sp_registers[PC][IF]))
+			{
+				// the miss overlaps the frozen cycles; a bubble still in IF/ID when the pipeline restarts costs one cycle
+				icache_bubble();
+				if(latency_tracker==access_latency)
+				{
+					stalls++;
+					icache->fetch_stalls++;
+				}
+			}
+			else if(raw_hazard==0)
 			{
 				pc_temp = sp_registers[PC][IF]+4;
 				//structural_mem_hazard_propagate=1;*/
@@ -1045,7 +1699,7 @@ void sim_pipe::run(unsigned cycles){
 				{
 				sp_registers[NPC][ID]=sp_registers[PC][IF]+4;
 				}
-				if(latency_tracker==data_memory_latency && ir[IF].opcode!=EOP)
+				if(latency_tracker==access_latency && ir[IF].opcode!=EOP)
 				{
 					sp_registers[PC][IF]=sp_registers[PC][IF]+4;
 				//	sp_registers[NPC][ID]=sp_registers[PC][IF]+4;
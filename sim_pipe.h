@@ -3,16 +3,39 @@
 
 #include <stdio.h>
 #include <string>
+#include <istream>
 
 using namespace std;
 
-#define PROGRAM_SIZE 50
+class mem_backend;
+class prefetcher;
+class mmio_device;
+class trace_writer;
+struct ooo_state;
+struct result_key;
+struct loop_state;
+struct deep_state;
+struct icache_state;
+struct mmio_state;
+struct check_state;
+struct xlat_state;
+struct interval_state;
+struct energy_state;
+struct energy_table;
+struct energy_interval;
+struct limit_state;
+struct sched_state;
+struct btc_state;
+struct pipeline_snapshot;
+
+#define PROGRAM_SIZE 1024 //instructions
 
 #define UNDEFINED 0xFFFFFFFF //used to initialize the registers
 #define NUM_SP_REGISTERS 9
 #define NUM_GP_REGISTERS 32
 #define NUM_OPCODES 16 
 #define NUM_STAGES 5
+#define STORE_BUFFER_BLOCK 8 //bytes covered by a store buffer entry (stores to the same block coalesce)
 
 typedef enum {PC, NPC, IR, A, B, IMM, COND, ALU_OUTPUT, LMD} sp_register_t;
 
@@ -37,9 +60,60 @@ typedef struct{
         string label; //for conditional branches, label of the target instruction - used only for parsing/debugging purposes
 } instruction_t;
 
+/*
+Miss-status holding register: tracks one memory access issued by the MEM stage
+that has not completed yet (used only when the memory stage is non-blocking)
+*/
+typedef struct{
+	int valid; //set while the access is outstanding
+	opcode_t opcode; //LW or SW
+	unsigned dest; //destination register of a LW
+	unsigned address; //effective address of the access
+	unsigned data; //value read by a LW (written back to dest on completion)
+	unsigned issue_cycle; //clock cycle in which the access left the MEM stage
+	unsigned ready_cycle; //clock cycle at whose beginning the access completes
+} mshr_t;
+
+/*
+Prefetch buffer entry: a line brought in by the data prefetcher
+*/
+typedef struct{
+	unsigned line; //line address (UNDEFINED if the entry is free)
+	unsigned ready_cycle; //clock cycle in which the line arrives from the data memory
+	int used; //set once a demand load hits the line
+	unsigned fill; //fill order (the oldest line is replaced first)
+} prefetch_entry_t;
+
+/*
+Store buffer entry: bytes written by one or more SW to the same aligned block
+that have not been drained to the data memory yet
+*/
+typedef struct{
+	unsigned block; //block address (multiple of STORE_BUFFER_BLOCK)
+	unsigned char data[STORE_BUFFER_BLOCK]; //buffered bytes
+	unsigned char mask[STORE_BUFFER_BLOCK]; //1 for the bytes written by the buffered stores
+} store_buffer_entry_t;
+
+
+/* ISA helpers shared by the simulation engines (defined in sim_pipe.cc) */
+unsigned alu(opcode_t opcode, unsigned a, unsigned b, unsigned imm, unsigned npc);
+bool taken_branch(opcode_t opcode, unsigned a);
+bool is_branch(opcode_t opcode);
+bool is_memory(opcode_t opcode);
+bool is_int_r(opcode_t opcode);
+bool is_int_imm(opcode_t opcode);
+bool reads_register(instruction_t instr, unsigned reg);
+bool writes_register(instruction_t instr, unsigned reg);
+unsigned load_word(const unsigned char *memory);
+const char *opcode_name(opcode_t opcode);
+void print_data_memory(const unsigned char *memory, unsigned start_address, unsigned end_address);
 
 class sim_pipe{
 
+	friend class sim_batch; //runs the detailed simulations of a batch (see sim_batch.h)
+	friend class sim_mt; //decodes the programs of the thread contexts (see sim_mt.h)
+	friend class sim_server; //caches decoded programs and installs them in pooled simulators (see sim_server.cc)
+
         //instruction memory 
         instruction_t instr_memory[PROGRAM_SIZE];
 
@@ -55,6 +129,11 @@ class sim_pipe{
 	//memory latency in clock cycles
 	unsigned data_memory_latency;
 
+	//timing model of the data memory (default: fixed data_memory_latency)
+	mem_backend *backend;
+	mem_backend *default_backend;
+	unsigned scheduled_latency; //latency of the access entering the MEM stage in the next cycle (non-blocking memory stage)
+
 	//statistics
 	unsigned clock_cycles;
 	unsigned stalls;
@@ -86,8 +165,151 @@ class sim_pipe{
 //	int structural_mem_hazard_propagate_3;
 	int mem_hazard_pipe_freeze;
 	unsigned latency_tracker;
+	unsigned access_latency; //number of cycles the MEM stage stays frozen for the current access
 	unsigned pc_temp;
 
+	/* non-blocking memory stage */
+	unsigned num_mshrs; //0 = blocking memory stage
+	mshr_t *mshrs;
+	int scoreboard[NUM_GP_REGISTERS]; //number of outstanding loads targeting each register
+	int deferred_load_wb; //set when the LW in the MEM/WB latch is written back by its MSHR
+	unsigned scoreboard_stalls;
+	unsigned mshr_full_stalls;
+
+	//non-blocking memory stage helpers
+	unsigned mshr_wait();
+	void mshr_allocate(opcode_t opcode, unsigned dest, unsigned address, unsigned data);
+	void mshr_complete();
+	unsigned mshr_outstanding();
+	int pending_load_hazard(instruction_t instr);
+	void schedule_memory_access(opcode_t opcode, unsigned address, unsigned pc);
+	unsigned demand_latency(opcode_t opcode, unsigned address, unsigned cycle);
+	void memory_access();
+
+	/* store buffer */
+	unsigned store_buffer_size; //number of entries; 0 = stores access the data memory directly
+	store_buffer_entry_t *store_buffer;
+	unsigned sb_head; //oldest entry (the one being drained)
+	unsigned sb_count; //number of valid entries
+	unsigned sb_drain_ready; //cycle at whose beginning the head entry is written to data memory (UNDEFINED if not draining)
+	int load_forwarded; //set when the LW entering the MEM stage is served by the store buffer
+	unsigned sb_full_stalls;
+	unsigned sb_forwards;
+	unsigned sb_coalesced;
+	unsigned sb_peak;
+	unsigned long long sb_occupancy; //sum over the clock cycles of the number of valid entries
+
+	//store buffer helpers
+	int store_buffer_find(unsigned block);
+	unsigned store_buffer_wait(unsigned address);
+	void store_buffer_start_drain(unsigned cycle);
+	void store_buffer_retire_head();
+	void store_buffer_insert(unsigned address, unsigned value);
+	int store_buffer_read(unsigned address, unsigned char *value);
+	void store_buffer_drain();
+
+	/* data prefetcher */
+	prefetcher *data_prefetcher; //NULL = no prefetching
+	prefetch_entry_t *prefetch_buffer;
+	unsigned prefetch_buffer_size;
+	unsigned prefetch_fills;
+	unsigned prefetches_issued;
+	unsigned prefetches_useful; //prefetched lines hit by at least one demand load
+	unsigned prefetches_late; //useful prefetches that had not arrived yet when first hit
+	unsigned prefetch_demand_loads;
+	unsigned prefetch_demand_hits;
+
+	//prefetcher helpers
+	void prefetch_train(unsigned pc, unsigned address, bool write, unsigned cycle);
+
+	/* out-of-order core (see sim_ooo.h) */
+	struct ooo_state *ooo;
+	void ooo_allocate(unsigned rob_size, unsigned rs_size, unsigned width);
+	void ooo_reset();
+	int ooo_load(unsigned rob_index, unsigned address, unsigned *value);
+
+	/* result cache (see result_cache.h) */
+	void cache_key(struct result_key *key);
+
+	/* steady-state loop acceleration (see sim_loop.h) */
+	struct loop_state *loop; //NULL = disabled
+	void loop_reset();
+	void loop_commit();
+	void loop_boundary(unsigned limit);
+	int loop_iteration();
+	void loop_memoize(const unsigned *signature);
+	int execute_functional(unsigned *pc, int *taken);
+	void pipeline_signature(unsigned *signature);
+
+	/* pipeline of configurable depth (see sim_deep.h) */
+	struct deep_state *deep; //NULL until configured
+	void deep_reset();
+
+	/* instruction cache (see sim_icache.h) */
+	struct icache_state *icache; //NULL = every fetch hits
+	void icache_reset();
+	int icache_wait(unsigned pc);
+	void icache_bubble();
+
+	/* memory-mapped devices and event scheduler (see mmio_device.h) */
+	struct mmio_state *mmio; //NULL = no devices
+	unsigned skipped_cycles;
+	mmio_device *find_device(unsigned address, unsigned *offset);
+	int device_access();
+
+	/* lockstep differential check of run() (see sim_check.h) */
+	struct check_state *check; //NULL = disabled
+	void check_reset();
+	void check_start();
+	void check_store(unsigned address, unsigned value);
+	int check_retire();
+
+	/* trace of the data memory accesses (see mem_trace.h) */
+	trace_writer *mem_trace; //NULL = no trace
+	void trace_access(opcode_t opcode, unsigned address, unsigned pc);
+
+	/* basic block translator (see sim_xlat.h) */
+	struct xlat_state *xlat; //NULL until run_translated() is first called
+	void xlat_reset();
+	struct xlat_block *xlat_translate(unsigned pc);
+	void xlat_start(unsigned pc);
+	unsigned start_pc();
+
+	/* parallel interval simulation (see sim_interval.h) */
+	struct interval_state *intervals; //NULL until run_intervals() is called
+	sim_pipe *interval_simulator();
+	static void release_simulator(sim_pipe *sim);
+
+	/* activity-based energy model (see sim_energy.h) */
+	struct energy_state *energy; //NULL = disabled
+	void energy_reset();
+	void energy_commit();
+	void energy_snapshot(struct energy_interval *snapshot);
+	void energy_open_interval(struct energy_interval *interval);
+
+	/* dataflow limit study (see sim_limit.h) */
+	struct limit_state *limit_study; //NULL = disabled
+	void limit_reset();
+	void limit_commit();
+
+	/* load-time list scheduling (see sim_sched.h) */
+	struct sched_state *sched; //NULL = programs loaded as written
+	void sched_reset();
+	void schedule_program(const bool *leader);
+	void schedule_reference();
+
+	/* basic-block timing cache (see sim_btc.h) */
+	struct btc_state *btc; //NULL = disabled
+	void btc_reset();
+	void btc_record();
+	void btc_boundary(unsigned limit);
+	void save_pipeline(struct pipeline_snapshot *snapshot);
+	void restore_pipeline(const struct pipeline_snapshot *snapshot);
+
+	/* data memory images (see mem_image.cc) */
+	void allocate_data_memory();
+	void release_data_memory();
+
 public:
 
 	//instantiates the simulator with a data memory of given size (in bytes) and latency (in clock cycles)
@@ -99,8 +321,140 @@ public:
 	//loads the assembly program in file "filename" in instruction memory at the specified address
 	void load_program(const char *filename, unsigned base_address=0x0);
 
+	//loads the assembly program read from "program" (same syntax as the file) in instruction memory at the specified address
+	void load_program(istream &program, unsigned base_address=0x0);
+
 	//runs the simulator for "cycles" clock cycles (run the program to completion if cycles=0) 
 	void run(unsigned cycles=0);
+
+	//runs the out-of-order core instead of the in-order pipeline for "cycles" clock cycles (run the program to completion if cycles=0)
+	//statistics are collected in the same counters as run(); a stall is a cycle, after the first commit, in which no instruction commits
+	void run_ooo(unsigned cycles=0);
+
+	//sets the window of the out-of-order core: reorder buffer entries, reservation stations and fetch/issue/commit width
+	//(default: 16 ROB entries, 8 reservation stations, width 1)
+	void set_ooo_window(unsigned rob_size, unsigned rs_size, unsigned width=1);
+
+	//sets the number of fetch, execute and memory stages of the pipeline simulated by run_deep() (at least one each; 0/0/0 releases the latches)
+	//the decode and write back stages are always one; the default 1/1/1 is the 5-stage pipeline of run()
+	void set_pipeline_depth(unsigned fetch_stages, unsigned execute_stages, unsigned memory_stages);
+
+	//runs the pipeline of configurable depth instead of the 5-stage pipeline for "cycles" clock cycles (run the program to completion if cycles=0)
+	//statistics are collected in the same counters as run(); store buffer and non-blocking memory stage are not supported
+	void run_deep(unsigned cycles=0);
+
+	//returns the number of stages of the pipeline simulated by run_deep() and its branch penalty in clock cycles
+	unsigned get_pipeline_depth();
+	unsigned get_branch_penalty();
+
+	//runs the program to completion, reusing the result of an identical simulation (same program, initial state and configuration)
+	//stored in directory "cache_dir" if there is one; otherwise simulates and stores the result. Returns true on a cache hit.
+	//a hit restores clock cycles, instructions executed and stalls, plus registers and data memory if "save_state" is set
+	//(the other statistics and the pipeline latches are not restored). Only the initial state can be looked up: if the
+	//simulation has already started, the program is simply run to completion. A run stopped by the lockstep check is not stored.
+	bool run_cached(const char *cache_dir, bool save_state=true);
+
+	//enables/disables the steady-state loop acceleration of run() (default memory model only; see sim_loop.h)
+	//once an iteration of a loop leaves the pipeline in the state it started from, the following iterations following
+	//the same path are executed functionally and credited the cycles, stalls and instructions of the detailed one
+	void set_loop_acceleration(bool enable);
+
+	//returns the number of loop iterations executed functionally / rolled back because they left the memoized path
+	unsigned get_accelerated_iterations();
+	unsigned get_loop_rollbacks();
+
+	//enables/disables the lockstep check of run() against a functional reference model (see sim_check.h): the architectural
+	//effects of every instruction written back are compared with the reference, and run() stops at the first divergence
+	//the reference starts from the state of the simulator at the first clock cycle; disables the loop acceleration while enabled
+	void set_lockstep_check(bool enable);
+
+	//returns the number of instructions checked / the clock cycle of the first divergence (UNDEFINED if none)
+	unsigned get_checked_instructions();
+	unsigned get_divergence_cycle();
+
+	//executes the program functionally with translated basic blocks (see sim_xlat.h), without timing, until at least "instructions"
+	//instructions have been executed (run to the EOP if instructions=0), stopping at a block boundary or at the EOP. Only before
+	//the first clock cycle: run() and the other timing models then start from the next instruction (memory-mapped devices are not supported)
+	void run_translated(unsigned instructions=0);
+
+	//returns the number of instructions executed by run_translated(), of basic blocks translated and of block exits that followed a direct link
+	unsigned long long get_translated_instructions();
+	unsigned get_translated_blocks();
+	unsigned long long get_chained_exits();
+
+	//runs the program to completion splitting it in intervals of about "interval" instructions, simulated in detail by run() in parallel on
+	//"threads" threads (0: one per processor) after "warmup" instructions (less than "interval") from functional checkpoints (see sim_interval.h)
+	//the statistics are the sums over the intervals; if "compare" is set, the whole program is also simulated serially, for reference
+	//only before the first clock cycle; the final registers and data memory are the ones of the last interval (the pipeline latches are not restored)
+	void run_intervals(unsigned interval, unsigned warmup, unsigned threads=0, bool compare=false);
+
+	//prints the statistics of each interval and, if run_intervals() compared with a serial simulation, the error of the stitched statistics
+	void print_interval_stats();
+
+	//returns the relative error of the stitched clock cycles against the serial simulation (0 if not compared)
+	float get_interval_cycle_error();
+
+	//enables the activity-based energy model of run() with the given energy table (see sim_energy.h; NULL disables it)
+	//with "interval_cycles" > 0, the activity is also broken down in intervals of that many clock cycles
+	void set_energy_model(const struct energy_table *table, unsigned interval_cycles=0);
+
+	//returns the total energy (dynamic and leakage, pJ), the average power (mW) and the energy per instruction (pJ); 0 if the model is disabled
+	float get_energy();
+	float get_average_power();
+	float get_energy_per_instruction();
+
+	//prints the activity counters, their energy, the totals and, if enabled, the breakdown by interval
+	void print_energy_stats();
+
+	//enables (or disables) the dataflow limit study of run() (see sim_limit.h): the instructions written back form a dynamic
+	//register and memory dependence graph whose critical path bounds the IPC; the stall cycles are also split by cause
+	void set_limit_study(bool enable=true);
+
+	//returns the critical path (clock cycles) of the dependence graph of the instructions written back so far, and the
+	//resulting ideal IPC (unit latencies, true dependences only); 0 if the study is disabled
+	unsigned long long get_critical_path();
+	float get_ideal_IPC();
+
+	//returns the clock cycles in which run() stalled on a RAW hazard, on a branch and on the data memory (limit study only)
+	unsigned get_raw_stall_cycles();
+	unsigned get_control_stall_cycles();
+	unsigned get_memory_stall_cycles();
+
+	//prints the critical path and ideal IPC of each model, and the IPC without each stall cause
+	void print_limit_stats();
+
+	//enables (or disables) the list scheduling of the programs loaded afterwards (see sim_sched.h): load_program reorders the
+	//instructions of each basic block to reduce the stalls of run(), with its hazard distances and data memory latency as cost model
+	//(the memory configuration at load time is used). With "measure" set, run() first simulates the original program from the same
+	//initial state, to measure the stall reduction
+	void set_scheduling(bool enable, bool measure=false);
+
+	//returns the stall cycles of the loaded program estimated by the cost model (one execution of each basic block), after scheduling
+	//or with the original order
+	unsigned get_estimated_stalls(bool scheduled=true);
+
+	//returns the clock cycles and stalls of the simulation of the original program (UNDEFINED if not measured)
+	unsigned get_reference_cycles();
+	unsigned get_reference_stalls();
+
+	//prints the scheduled basic blocks, the estimated and, if measured, the measured stall reduction
+	void print_schedule_stats();
+
+	//enables (or disables) the basic-block timing cache of run() (see sim_btc.h): a basic block entered with a pipeline state
+	//already seen is executed functionally and credited the cycles, stalls and instructions measured the first time, instead of
+	//being simulated cycle by cycle. Every "resample"-th hit of a block is simulated in detail again (0 = never) to refresh the
+	//stored timing and measure the error. Exact with the default memory model, approximate with a mem_backend
+	void set_block_timing(bool enable, unsigned resample=64);
+
+	//returns the basic blocks credited from the cache and the ones simulated in detail
+	unsigned long long get_replayed_blocks();
+	unsigned long long get_detailed_blocks();
+
+	//returns the cycle error of the resampled blocks (sum of |detailed - stored cycles| over the detailed cycles)
+	float get_block_timing_error();
+
+	//prints the size of the cache, the replayed and detailed blocks and the resampling error
+	void print_block_timing_stats();
 	
 	//resets the state of the simulator
         /* Note: 
@@ -140,9 +494,77 @@ public:
 	//returns the number of stalls added by processor
 	unsigned get_stalls();
 
+	//selects the timing model of the data memory (e.g., a dram_backend); NULL restores the fixed data_memory_latency
+	//the backend is not owned by the simulator
+	void set_mem_backend(mem_backend *backend);
+
+	//attaches a data prefetcher (e.g., a stride_prefetcher) with a prefetch buffer of the given number of lines; NULL detaches it
+	//the prefetcher observes the LW/SW stream of the MEM stage and LW hitting a prefetched line only wait for it to arrive
+	//the prefetcher is not owned by the simulator
+	void set_prefetcher(prefetcher *p, unsigned buffer_lines=16);
+
+	//prefetcher statistics: prefetches issued, useful (hit by a demand load), late (useful but not arrived when hit)
+	unsigned get_prefetches_issued();
+	unsigned get_prefetches_useful();
+	unsigned get_prefetches_late();
+
+	//prints accuracy (useful/issued), coverage (demand loads served by the prefetch buffer) and timeliness (useful prefetches that arrived in time)
+	void print_prefetch_stats();
+
+	//makes the memory stage non-blocking with the given number of miss-status holding registers (0 restores the blocking memory stage)
+	//instructions that do not depend on an outstanding load keep flowing; dependent ones are stalled by a register scoreboard
+	void set_mshrs(unsigned mshrs);
+
+	//returns the number of stalls caused by instructions waiting on outstanding loads (non-blocking memory stage only)
+	unsigned get_scoreboard_stalls();
+
+	//returns the number of stalls caused by memory instructions waiting for a free MSHR (non-blocking memory stage only)
+	unsigned get_mshr_full_stalls();
+
+	//adds a store buffer with the given number of entries (at least 2; 0 removes the store buffer)
+	//SW retire without waiting for the data memory, stores to the same block coalesce and LW are forwarded from the buffer
+	void set_store_buffer(unsigned entries);
+
+	//store buffer statistics: stalls due to a full buffer, loads forwarded from the buffer, stores coalesced into an existing entry,
+	//average and peak number of valid entries
+	unsigned get_store_buffer_stalls();
+	unsigned get_store_buffer_forwards();
+	unsigned get_store_buffer_coalesced();
+	float get_store_buffer_occupancy();
+	unsigned get_store_buffer_peak();
+
+	//adds an instruction cache of "size" bytes with lines of "line_size" bytes and the given associativity to the IF stage of run()
+	//a miss stalls the fetch for "miss_latency" clock cycles; a fetch buffer of "buffer_lines" lines streams the lines following each miss
+	//(0: no fetch buffer). A zero size removes the instruction cache (every fetch hits)
+	void set_icache(unsigned size, unsigned line_size, unsigned assoc, unsigned miss_latency, unsigned buffer_lines=0);
+
+	//instruction cache statistics: misses (fetch buffer hits excluded), fetches served by the fetch buffer, bubbles inserted by the IF stage
+	unsigned get_icache_misses();
+	unsigned get_fetch_buffer_hits();
+	unsigned get_fetch_stalls();
+
+	//maps "device" (e.g., a timer_device) at addresses [base_address, base_address+size) of run(): LW/SW to the range are served by the device,
+	//with its latency, instead of the data memory, and the events scheduled by the device fire at the beginning of their clock cycle
+	//the device is not owned by the simulator
+	void attach_device(mmio_device *device, unsigned base_address, unsigned size);
+
+	//writes a binary trace of the LW/SW entering the MEM stage of run() to "filename" (see mem_trace.h); NULL closes the trace
+	void set_mem_trace(const char *filename);
+
+	//returns the number of clock cycles skipped by run() without simulating them stage by stage: while the memory stage is frozen
+	//waiting for an access, run() jumps to the end of the access or to the next device event
+	unsigned get_skipped_cycles();
+
 	//prints the content of the data memory within the specified address range
 	void print_memory(unsigned start_address, unsigned end_address);
 
+	//maps the binary file "filename" as the content of the data memory from "address" (a multiple of the page size): the file is read
+	//when its pages are first accessed and never written (the simulator writes to private copies); reset() overwrites the image
+	void load_memory_image(const char *filename, unsigned address=0);
+
+	//writes the content of the data memory within the specified address range to the binary file "filename"
+	void dump_memory(const char *filename, unsigned start_address, unsigned end_address);
+
 	// writes an integer value to data memory at the specified address (use little-endian format: https://en.wikipedia.org/wiki/Endianness)
 	void write_memory(unsigned address, unsigned value);
 
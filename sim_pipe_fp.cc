@@ -0,0 +1,634 @@
+#include "sim_pipe_fp.h"
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <string>
+#include <iomanip>
+#include <map>
+
+//#define DEBUG
+
+using namespace std;
+
+//used for debugging purposes
+static const char *reg_names[NUM_SP_REGISTERS] = {"PC", "NPC", "IR", "A", "B", "IMM", "COND", "ALU_OUTPUT", "LMD"};
+static const char *stage_names[NUM_STAGES] = {"IF", "ID", "EX", "MEM", "WB"};
+static const char *instr_names[NUM_OPCODES] = {"LW", "SW", "ADD", "ADDI", "SUB", "SUBI", "XOR", "BEQZ", "BNEZ", "BLTZ", "BGTZ", "BLEZ", "BGEZ", "JUMP", "EOP", "NOP", "LWS", "SWS", "ADDS", "SUBS", "MULTS", "DIVS", "MULT", "DIV"};
+static const char *unit_names[NUM_UNIT_TYPES] = {"INTEGER", "ADDER", "MULTIPLIER", "DIVIDER", "MULDIV"};
+
+/* =============================================================
+
+   HELPER FUNCTIONS
+
+   ============================================================= */
+
+
+/* converts integer into array of unsigned char - little indian */
+static inline void int2char(unsigned value, unsigned char *buffer){
+	memcpy(buffer, &value, sizeof value);
+}
+
+/* converts array of char into integer - little indian */
+static inline unsigned char2int(unsigned char *buffer){
+	unsigned d;
+	memcpy(&d, buffer, sizeof d);
+	return d;
+}
+
+/* bit pattern of a float and vice versa (floating point values travel through the latches as unsigned) */
+static inline unsigned float2unsigned(float value){
+	unsigned d;
+	memcpy(&d, &value, sizeof d);
+	return d;
+}
+
+static inline float unsigned2float(unsigned value){
+	float f;
+	memcpy(&f, &value, sizeof f);
+	return f;
+}
+
+static bool is_branch(opcode_t opcode){
+        return (opcode == BEQZ || opcode == BNEZ || opcode == BLTZ || opcode == BLEZ || opcode == BGTZ || opcode == BGEZ || opcode == JUMP);
+}
+
+static bool is_memory(opcode_t opcode){
+        return (opcode == LW || opcode == SW || opcode == LWS || opcode == SWS);
+}
+
+static bool is_fp_alu(opcode_t opcode){
+        return (opcode == ADDS || opcode == SUBS || opcode == MULTS || opcode == DIVS);
+}
+
+static bool is_int_r(opcode_t opcode){
+        return (opcode == ADD || opcode == SUB || opcode == XOR || opcode == MULT || opcode == DIV);
+}
+
+static bool is_int_imm(opcode_t opcode){
+        return (opcode == ADDI || opcode == SUBI);
+}
+
+/* returns true if the instruction is a taken branch/jump */
+static bool taken_branch(opcode_t opcode, unsigned a){
+        switch(opcode){
+                case BEQZ: return (a==0);
+                case BNEZ: return (a!=0);
+                case BGTZ: return ((int)a>0);
+                case BGEZ: return ((int)a>=0);
+                case BLTZ: return ((int)a<0);
+                case BLEZ: return ((int)a<=0);
+                case JUMP: return true;
+                default: return false;
+        }
+}
+
+/* true if the instruction reads src1 / src2 */
+static bool reads_src1(opcode_t opcode){
+	return (is_int_r(opcode) || is_int_imm(opcode) || is_fp_alu(opcode) || is_memory(opcode) || (is_branch(opcode) && opcode != JUMP));
+}
+
+static bool reads_src2(opcode_t opcode){
+	return (is_int_r(opcode) || is_fp_alu(opcode) || opcode == SW || opcode == SWS);
+}
+
+/* execution unit type of each instruction */
+exe_unit_t sim_pipe_fp::unit_of(opcode_t opcode){
+	switch(opcode){
+		case ADDS:
+		case SUBS:
+			return ADDER;
+		case MULTS:
+			return MULTIPLIER;
+		case DIVS:
+			return DIVIDER;
+		case MULT:
+		case DIV:
+			return MULDIV;
+		default:
+			return INTEGER;
+	}
+}
+
+/* true if the source operand (src1 or src2) of the instruction is a floating point register */
+bool sim_pipe_fp::reads_fp(opcode_t opcode, bool src2){
+	if (is_fp_alu(opcode)) return true;
+	return (src2 && opcode == SWS);
+}
+
+/* true if the destination of the instruction is a floating point register */
+bool sim_pipe_fp::writes_fp(opcode_t opcode){
+	return (is_fp_alu(opcode) || opcode == LWS);
+}
+
+bool sim_pipe_fp::writes_register(opcode_t opcode){
+	return (is_int_r(opcode) || is_int_imm(opcode) || is_fp_alu(opcode) || opcode == LW || opcode == LWS);
+}
+
+/* scoreboard entry of the destination / of a source operand (src2 selects which one) of the instruction */
+int *sim_pipe_fp::pending_dest(instruction_t instr){
+	return writes_fp(instr.opcode) ? &fp_pending[instr.dest] : &int_pending[instr.dest];
+}
+
+int *sim_pipe_fp::pending_src(instruction_t instr, bool src2){
+	unsigned reg = src2 ? instr.src2 : instr.src1;
+	return reads_fp(instr.opcode, src2) ? &fp_pending[reg] : &int_pending[reg];
+}
+
+/* value of a source operand (floating point registers as bit patterns) */
+unsigned sim_pipe_fp::read_register(instruction_t instr, bool src2){
+	unsigned reg = src2 ? instr.src2 : instr.src1;
+	if (reads_fp(instr.opcode, src2)) return float2unsigned(fp_registers[reg]);
+	return int_registers[reg];
+}
+
+/* =============================================================
+
+   CODE PROVIDED - NO NEED TO MODIFY FUNCTIONS BELOW
+
+   ============================================================= */
+
+void sim_pipe_fp::load_program(const char *filename, unsigned base_address){
+
+   /* initializing the base instruction address */
+   instr_base_address = base_address;
+
+   /* creating a map with the valid opcodes and with the valid labels */
+   map<string, opcode_t> opcodes; //for opcodes
+   map<string, unsigned> labels;  //for branches
+   for (int i=0; i<NUM_OPCODES; i++)
+	 opcodes[string(instr_names[i])]=(opcode_t)i;
+
+   /* opening the assembly file */
+   ifstream fin(filename, ios::in | ios::binary);
+   if (!fin.is_open()) {
+      cerr << "error: open file " << filename << " failed!" << endl;
+      exit(-1);
+   }
+
+   /* parsing the assembly file line by line */
+   string line;
+   unsigned instruction_nr = 0;
+   while (getline(fin,line)){
+	if (instruction_nr == PROGRAM_SIZE){
+		cerr << "error: the program does not fit in the instruction memory (" << PROGRAM_SIZE << " instructions)" << endl;
+		exit(-1);
+	}
+	// set the instruction field
+	char *str = const_cast<char*>(line.c_str());
+	char *save;
+
+  	// tokenize the instruction
+	char *token = strtok_r(str, " \t", &save);
+	map<string, opcode_t>::iterator search = opcodes.find(token);
+        if (search == opcodes.end()){
+		// this is a label for a branch - extract it and save it in the labels map
+		string label = string(token).substr(0, string(token).length() - 1);
+		labels[label]=instruction_nr;
+                // move to next token, which must be the instruction opcode
+		token = strtok_r(NULL, " \t", &save);
+		search = opcodes.find(token);
+		if (search == opcodes.end()) cout << "ERROR: invalid opcode: " << token << " !" << endl;
+	}
+	instr_memory[instruction_nr].opcode = search->second;
+
+	//reading remaining parameters (registers are R<n> or F<n>)
+	char *par1;
+	char *par2;
+	char *par3;
+	switch(instr_memory[instruction_nr].opcode){
+		case ADD:
+		case SUB:
+		case XOR:
+		case MULT:
+		case DIV:
+		case ADDS:
+		case SUBS:
+		case MULTS:
+		case DIVS:
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			par3 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].dest = atoi(strtok_r(par1, "RF", &save));
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(par2, "RF", &save));
+			instr_memory[instruction_nr].src2 = atoi(strtok_r(par3, "RF", &save));
+			break;
+		case ADDI:
+		case SUBI:
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			par3 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].dest = atoi(strtok_r(par1, "R", &save));
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(par2, "R", &save));
+			instr_memory[instruction_nr].immediate = strtoul (par3, NULL, 0);
+			break;
+		case LW:
+		case LWS:
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].dest = atoi(strtok_r(par1, "RF", &save));
+			instr_memory[instruction_nr].immediate = strtoul(strtok_r(par2, "()", &save), NULL, 0);
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(NULL, "R", &save));
+			break;
+		case SW:
+		case SWS:
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].src2 = atoi(strtok_r(par1, "RF", &save));
+			instr_memory[instruction_nr].immediate = strtoul(strtok_r(par2, "()", &save), NULL, 0);
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(NULL, "R", &save));
+			break;
+		case BEQZ:
+		case BNEZ:
+		case BLTZ:
+		case BGTZ:
+		case BLEZ:
+		case BGEZ:
+			par1 = strtok_r(NULL, " \t", &save);
+			par2 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].src1 = atoi(strtok_r(par1, "R", &save));
+			instr_memory[instruction_nr].label = par2;
+			break;
+		case JUMP:
+			par2 = strtok_r(NULL, " \t", &save);
+			instr_memory[instruction_nr].label = par2;
+		default:
+			break;
+
+	}
+
+	/* increment instruction number before moving to next line */
+	instruction_nr++;
+   }
+   //reconstructing the labels of the branch operations
+   int i = 0;
+   while(i < PROGRAM_SIZE){
+   	instruction_t instr = instr_memory[i];
+	if (instr.opcode == EOP) break;
+	if (is_branch(instr.opcode)){
+		instr_memory[i].immediate = (labels[instr.label] - i - 1) << 2;
+	}
+        i++;
+   }
+
+}
+
+/* writes an integer value to data memory at the specified address (use little-endian format: https://en.wikipedia.org/wiki/Endianness) */
+void sim_pipe_fp::write_memory(unsigned address, unsigned value){
+	int2char(value,data_memory+address);
+}
+
+/* prints the content of the data memory within the specified address range */
+void sim_pipe_fp::print_memory(unsigned start_address, unsigned end_address){
+	ios::fmtflags flags = cout.flags();
+	char fill = cout.fill();
+	cout << "data_memory[0x" << hex << setw(8) << setfill('0') << start_address << ":0x" << hex << setw(8) << setfill('0') <<  end_address << "]" << endl;
+	for (unsigned i=start_address; i<end_address; i++){
+		if (i%4 == 0) cout << "0x" << hex << setw(8) << setfill('0') << i << ": ";
+		cout << hex << setw(2) << setfill('0') << int(data_memory[i]) << " ";
+		if (i%4 == 3) cout << endl;
+	}
+	cout.flags(flags);
+	cout.fill(fill);
+}
+
+/* prints the values of the registers */
+void sim_pipe_fp::print_registers(){
+        cout << "Special purpose registers:" << endl;
+        unsigned i, s;
+        for (s=0; s<NUM_STAGES; s++){
+                cout << "Stage: " << stage_names[s] << endl;
+                for (i=0; i< NUM_SP_REGISTERS; i++)
+                        if ((sp_register_t)i != IR && (sp_register_t)i != COND && get_sp_register((sp_register_t)i, (stage_t)s)!=UNDEFINED) cout << reg_names[i] << " = " << dec <<  get_sp_register((sp_register_t)i, (stage_t)s) << hex << " / 0x" << get_sp_register((sp_register_t)i, (stage_t)s) << endl;
+        }
+        cout << "Integer registers:" << endl;
+        for (i=0; i< NUM_GP_REGISTERS; i++)
+                if (get_int_register(i)!=(int)UNDEFINED) cout << "R" << dec << i << " = " << get_int_register(i) << hex << " / 0x" << get_int_register(i) << endl;
+        cout << "Floating point registers:" << endl;
+        for (i=0; i< NUM_GP_REGISTERS; i++)
+                if (float2unsigned(get_fp_register(i))!=UNDEFINED) cout << "F" << dec << i << " = " << get_fp_register(i) << hex << " / 0x" << float2unsigned(get_fp_register(i)) << endl;
+}
+
+/* initializes the pipeline simulator */
+sim_pipe_fp::sim_pipe_fp(unsigned mem_size, unsigned mem_latency){
+	data_memory_size = mem_size;
+	data_memory_latency = mem_latency;
+	data_memory = new unsigned char[data_memory_size];
+	for (int t=0; t<NUM_UNIT_TYPES; t++) num_units[t] = 0;
+	reset();
+}
+
+/* deallocates the pipeline simulator */
+sim_pipe_fp::~sim_pipe_fp(){
+	delete [] data_memory;
+	for (int t=0; t<NUM_UNIT_TYPES; t++)
+		for (unsigned u=0; u<num_units[t]; u++) delete [] units[t][u].slots;
+}
+
+/* execution statistics */
+unsigned sim_pipe_fp::get_clock_cycles(){return clock_cycles;}
+
+unsigned sim_pipe_fp::get_instructions_executed(){return instructions_executed;}
+
+unsigned sim_pipe_fp::get_stalls(){return stalls;}
+
+unsigned sim_pipe_fp::get_structural_stalls(){return structural_stalls;}
+
+unsigned sim_pipe_fp::get_raw_stalls(){return raw_stalls;}
+
+unsigned sim_pipe_fp::get_waw_stalls(){return waw_stalls;}
+
+float sim_pipe_fp::get_IPC(){return (float)instructions_executed/clock_cycles;}
+
+/* =============================================================
+
+   CODE TO BE COMPLETED
+
+   ============================================================= */
+
+void sim_pipe_fp::init_exec_unit(exe_unit_t exec_unit, unsigned latency, unsigned instances, bool pipelined){
+	if (num_units[exec_unit] + instances > MAX_UNITS){
+		cerr << "error: at most " << MAX_UNITS << " " << unit_names[exec_unit] << " units are supported" << endl;
+		exit(-1);
+	}
+	for (unsigned i=0; i<instances; i++){
+		unit_t *unit = &units[exec_unit][num_units[exec_unit]++];
+		unit->type = exec_unit;
+		unit->latency = latency;
+		unit->pipelined = pipelined;
+		unit->slots = new exe_slot_t[latency+1];
+		for (unsigned s=0; s<=latency; s++) unit->slots[s].valid = 0;
+	}
+}
+
+/* empties the execution units */
+void sim_pipe_fp::release_units(){
+	for (int t=0; t<NUM_UNIT_TYPES; t++)
+		for (unsigned u=0; u<num_units[t]; u++)
+			for (unsigned s=0; s<=units[t][u].latency; s++) units[t][u].slots[s].valid = 0;
+}
+
+/* reset the state of the pipeline simulator */
+void sim_pipe_fp::reset(){
+
+	// initializing data memory to all 0xFF
+	for (unsigned i=0; i<data_memory_size; i++) data_memory[i]=0xFF;
+
+	// initializing instuction memory
+        for (int i=0; i<PROGRAM_SIZE;i++){
+                instr_memory[i].opcode=(opcode_t)NOP;
+                instr_memory[i].src1=UNDEFINED;
+                instr_memory[i].src2=UNDEFINED;
+                instr_memory[i].dest=UNDEFINED;
+                instr_memory[i].immediate=UNDEFINED;
+        }
+	instr_base_address = UNDEFINED;
+
+	// registers initialization
+	for (int i=0; i<NUM_GP_REGISTERS; i++){
+		int_registers[i]=UNDEFINED;
+		fp_registers[i]=unsigned2float(UNDEFINED);
+		int_pending[i]=0;
+		fp_pending[i]=0;
+	}
+	for (int i=0; i<NUM_SP_REGISTERS; i++)
+		for (int j=0; j<NUM_STAGES; j++) sp_registers[i][j]=UNDEFINED;
+
+	// latches and execution units (the units themselves are configuration and are preserved)
+	if_id.opcode = NOP;
+	if_id.src1 = UNDEFINED;
+	if_id.src2 = UNDEFINED;
+	if_id.dest = UNDEFINED;
+	if_id.immediate = UNDEFINED;
+	ex_mem = if_id;
+	mem_wb = if_id;
+	release_units();
+	issue_sequence = 0;
+
+	branch_pending = 0;
+	mem_wait = 0;
+	eop_issued = 0;
+	started = 0;
+
+	// statistics
+	clock_cycles = 0;
+	stalls = 0;
+	instructions_executed = 0;
+	structural_stalls = 0;
+	raw_stalls = 0;
+	waw_stalls = 0;
+}
+
+//returns value of special purpose register (see sim_pipe_fp.h for more details)
+unsigned sim_pipe_fp::get_sp_register(sp_register_t reg, stage_t s){
+	return sp_registers[reg][s];
+}
+
+int sim_pipe_fp::get_int_register(unsigned reg){
+	return int_registers[reg];
+}
+
+void sim_pipe_fp::set_int_register(unsigned reg, int value){
+	int_registers[reg] = value;
+}
+
+float sim_pipe_fp::get_fp_register(unsigned reg){
+	return fp_registers[reg];
+}
+
+void sim_pipe_fp::set_fp_register(unsigned reg, float value){
+	fp_registers[reg] = value;
+}
+
+/* returns a unit of the given type that can accept an instruction in the next cycle, NULL if all of them are busy */
+unit_t *sim_pipe_fp::free_unit(exe_unit_t type){
+	if (num_units[type] == 0){
+		cerr << "error: no " << unit_names[type] << " execution unit (see init_exec_unit)" << endl;
+		exit(-1);
+	}
+	for (unsigned u=0; u<num_units[type]; u++){
+		unit_t *unit = &units[type][u];
+		unsigned busy = 0;
+		for (unsigned s=0; s<=unit->latency; s++) if (unit->slots[s].valid) busy++;
+		// a pipelined unit holds at most one instruction per execution cycle
+		if (busy == 0 || (unit->pipelined && busy <= unit->latency)) return unit;
+	}
+	return NULL;
+}
+
+/* returns the hazard preventing the instruction in IF/ID from being issued: 0 none, 1 structural, 2 RAW, 3 WAW */
+int sim_pipe_fp::issue_hazard(instruction_t instr){
+	opcode_t opcode = instr.opcode;
+	if (opcode == EOP){
+		// EOP leaves the execution stage after every other instruction
+		for (int t=0; t<NUM_UNIT_TYPES; t++)
+			for (unsigned u=0; u<num_units[t]; u++)
+				for (unsigned s=0; s<=units[t][u].latency; s++) if (units[t][u].slots[s].valid) return 1;
+		return 0;
+	}
+	if (free_unit(unit_of(opcode)) == NULL) return 1;
+	if (reads_src1(opcode) && *pending_src(instr, false) > 0) return 2;
+	if (reads_src2(opcode) && *pending_src(instr, true) > 0) return 2;
+	if (writes_register(opcode) && *pending_dest(instr) > 0) return 3;
+	return 0;
+}
+
+/* computes the result of an instruction leaving the execution stage (ALU_OUTPUT), and sets COND for branches */
+unsigned sim_pipe_fp::execute(exe_slot_t *slot){
+	unsigned a = slot->a, b = slot->b;
+	sp_registers[COND][MEM] = UNDEFINED;
+	switch(slot->instr.opcode){
+		case ADD: return a+b;
+		case SUB: return a-b;
+		case XOR: return a^b;
+		case MULT: return (int)a*(int)b;
+		case DIV: return (b != 0) ? (unsigned)((int)a/(int)b) : UNDEFINED;
+		case ADDI:
+		case LW:
+		case SW:
+		case LWS:
+		case SWS:
+			return a+slot->imm;
+		case SUBI: return a-slot->imm;
+		case ADDS: return float2unsigned(unsigned2float(a) + unsigned2float(b));
+		case SUBS: return float2unsigned(unsigned2float(a) - unsigned2float(b));
+		case MULTS: return float2unsigned(unsigned2float(a) * unsigned2float(b));
+		case DIVS: return float2unsigned(unsigned2float(a) / unsigned2float(b));
+		case BEQZ:
+		case BNEZ:
+		case BLTZ:
+		case BGTZ:
+		case BLEZ:
+		case BGEZ:
+		case JUMP:
+			// ALU_OUTPUT is the address of the next instruction
+			if (taken_branch(slot->instr.opcode, a)){
+				sp_registers[COND][MEM] = 0;
+				return slot->npc + slot->imm;
+			}
+			return slot->npc;
+		default:
+			return UNDEFINED;
+	}
+}
+
+// Note: processing the stages in reverse order simplifies the data propagation through pipeline registers
+void sim_pipe_fp::run(unsigned cycles){
+
+	unsigned start_cycles = clock_cycles;
+	/* initialization at the beginning of simulation */
+	if (clock_cycles == 0) sp_registers[PC][IF]=instr_base_address;
+
+	/* ====== MAIN SIMULATION LOOP (one iteration per clock cycle)  ========= */
+	while(cycles==0 || clock_cycles-start_cycles!=cycles){
+
+		/* ============   WB stage   ============  */
+		opcode_t opcode = mem_wb.opcode;
+		if (opcode == EOP) break;
+		if (opcode != NOP){
+			if (writes_register(opcode)){
+				unsigned value = (opcode == LW || opcode == LWS) ? sp_registers[LMD][WB] : sp_registers[ALU_OUTPUT][WB];
+				if (writes_fp(opcode)) fp_registers[mem_wb.dest] = unsigned2float(value);
+				else int_registers[mem_wb.dest] = value;
+				(*pending_dest(mem_wb))--;
+			}
+			instructions_executed++;
+		}
+		mem_wb.opcode = NOP;
+
+		/* ============   MEM stage   ===========  */
+		if (ex_mem.opcode != NOP){
+			if (mem_wait > 0){
+				// waiting for the data memory: the MEM/WB latch gets a bubble
+				mem_wait--;
+				sp_registers[ALU_OUTPUT][WB] = UNDEFINED;
+				sp_registers[LMD][WB] = UNDEFINED;
+			} else {
+				unsigned address = sp_registers[ALU_OUTPUT][MEM];
+				sp_registers[LMD][WB] = UNDEFINED;
+				if (is_memory(ex_mem.opcode) && (data_memory_size < 4 || address > data_memory_size - 4)){
+					cerr << "error: access to address 0x" << hex << address << dec << " outside the data memory" << endl;
+					exit(-1);
+				}
+				if (ex_mem.opcode == LW || ex_mem.opcode == LWS) sp_registers[LMD][WB] = char2int(data_memory + address);
+				if (ex_mem.opcode == SW || ex_mem.opcode == SWS) write_memory(address, sp_registers[B][MEM]);
+				if (is_branch(ex_mem.opcode)){
+					// the outcome is known: fetch resumes from the next instruction
+					sp_registers[PC][IF] = address;
+					branch_pending = 0;
+				}
+				sp_registers[ALU_OUTPUT][WB] = address;
+				mem_wb = ex_mem;
+				ex_mem.opcode = NOP;
+			}
+		}
+
+		/* ============   EXE stage   ===========  */
+		// the oldest completed instruction moves to EX/MEM; the others wait in their unit
+		exe_slot_t *done = NULL;
+		for (int t=0; t<NUM_UNIT_TYPES; t++)
+			for (unsigned u=0; u<num_units[t]; u++)
+				for (unsigned s=0; s<=units[t][u].latency; s++){
+					exe_slot_t *slot = &units[t][u].slots[s];
+					if (!slot->valid) continue;
+					if (slot->remaining > 0) slot->remaining--;
+					else if (ex_mem.opcode == NOP && (done == NULL || slot->sequence < done->sequence)) done = slot;
+				}
+		if (done != NULL){
+			sp_registers[ALU_OUTPUT][MEM] = execute(done);
+			sp_registers[B][MEM] = is_branch(done->instr.opcode) ? UNDEFINED : done->b;
+			ex_mem = done->instr;
+			mem_wait = is_memory(done->instr.opcode) ? data_memory_latency : 0;
+			done->valid = 0;
+		}
+
+		/* ============   ID stage   ============  */
+		int issued = 0;
+		if (if_id.opcode != NOP){
+			int hazard = issue_hazard(if_id);
+			if (hazard == 1) structural_stalls++;
+			if (hazard == 2) raw_stalls++;
+			if (hazard == 3) waw_stalls++;
+			if (hazard == 0){
+				unit_t *unit = free_unit(unit_of(if_id.opcode));
+				exe_slot_t *slot = unit->slots;
+				while (slot->valid) slot++;
+				slot->valid = 1;
+				slot->instr = if_id;
+				slot->a = reads_src1(if_id.opcode) ? read_register(if_id, false) : UNDEFINED;
+				slot->b = reads_src2(if_id.opcode) ? read_register(if_id, true) : UNDEFINED;
+				slot->imm = (is_int_imm(if_id.opcode) || is_memory(if_id.opcode) || is_branch(if_id.opcode)) ? if_id.immediate : UNDEFINED;
+				slot->npc = sp_registers[NPC][ID];
+				slot->remaining = unit->latency;
+				slot->sequence = issue_sequence++;
+				if (writes_register(if_id.opcode)) (*pending_dest(if_id))++;
+				if (if_id.opcode == EOP) eop_issued = 1;
+
+				sp_registers[A][EXE] = slot->a;
+				sp_registers[B][EXE] = slot->b;
+				sp_registers[IMM][EXE] = slot->imm;
+				sp_registers[NPC][EXE] = slot->npc;
+				if_id.opcode = NOP;
+				started = 1;
+				issued = 1;
+			}
+		}
+		if (started && !eop_issued && !issued) stalls++;
+
+		/* ============   IF stage   ============  */
+		if (if_id.opcode == NOP && !branch_pending && !eop_issued){
+			unsigned pc = sp_registers[PC][IF];
+			if_id = instr_memory[(pc - instr_base_address)/4];
+			if (if_id.opcode == EOP){
+				sp_registers[NPC][ID] = pc;
+			} else {
+				sp_registers[PC][IF] = pc + 4;
+				sp_registers[NPC][ID] = pc + 4;
+			}
+			// stop fetching until the branch outcome is known
+			if (is_branch(if_id.opcode)) branch_pending = 1;
+		}
+
+		clock_cycles++; // increase clock cycles count
+	}
+}
@@ -0,0 +1,204 @@
+#ifndef SIM_PIPE_FP_H_
+#define SIM_PIPE_FP_H_
+
+#include <stdio.h>
+#include <string>
+
+using namespace std;
+
+#define PROGRAM_SIZE 50
+
+#define UNDEFINED 0xFFFFFFFF //used to initialize the registers
+#define NUM_SP_REGISTERS 9
+#define NUM_GP_REGISTERS 32
+#define NUM_OPCODES 24
+#define NUM_STAGES 5
+#define NUM_UNIT_TYPES 5
+#define MAX_UNITS 10 //maximum number of instances of each execution unit type
+
+typedef enum {PC, NPC, IR, A, B, IMM, COND, ALU_OUTPUT, LMD} sp_register_t;
+
+typedef enum {LW, SW, ADD, ADDI, SUB, SUBI, XOR, BEQZ, BNEZ, BLTZ, BGTZ, BLEZ, BGEZ, JUMP, EOP, NOP, LWS, SWS, ADDS, SUBS, MULTS, DIVS, MULT, DIV} opcode_t;
+
+typedef enum {IF, ID, EXE, MEM, WB} stage_t;
+
+/*
+Execution unit types:
+INTEGER: integer ALU, branches and address computation of the memory instructions
+ADDER: ADDS, SUBS
+MULTIPLIER: MULTS
+DIVIDER: DIVS
+MULDIV: integer MULT, DIV
+*/
+typedef enum {INTEGER, ADDER, MULTIPLIER, DIVIDER, MULDIV} exe_unit_t;
+
+/*
+Instruction encoding:
+ADD/SUB/XOR/MULT/DIV <dest> <src1> <src2>       (integer registers R0-R31)
+ADDS/SUBS/MULTS/DIVS <dest> <src1> <src2>       (floating point registers F0-F31)
+ADDI/SUBI <dest> <src1> <immediate>
+LW <dest> <immediate>(<src1>) - LWS loads into a floating point register
+SW <src2> <immediate>(<src1>) - SWS stores a floating point register
+BRANCH <src1> <immediate>
+*/
+typedef struct{
+        opcode_t opcode; //opcode
+        unsigned src1; //source register #1 - see instruction encoding above
+        unsigned src2; //source register #2 - see instruction encoding above
+        unsigned dest; //destination register
+        unsigned immediate; //immediate field
+        string label; //for conditional branches, label of the target instruction - used only for parsing/debugging purposes
+} instruction_t;
+
+/* instruction in an execution unit */
+typedef struct{
+	int valid;
+	instruction_t instr;
+	unsigned a, b, imm, npc; //operands read in ID
+	unsigned remaining; //clock cycles left before the result is available
+	unsigned sequence; //issue order (the oldest completed instruction leaves the execution stage first)
+} exe_slot_t;
+
+/*
+Execution unit: "latency" additional clock cycles in the execution stage (latency 0 = one cycle).
+A non-pipelined unit holds one instruction at a time; a pipelined one accepts a new instruction every clock cycle.
+A completed instruction waits in its unit until the EX/MEM latch is free.
+*/
+typedef struct{
+	exe_unit_t type;
+	unsigned latency;
+	int pipelined;
+	exe_slot_t *slots; //latency+1 entries
+} unit_t;
+
+class sim_pipe_fp{
+
+        //instruction memory
+        instruction_t instr_memory[PROGRAM_SIZE];
+
+        //base address in the instruction memory where the program is loaded
+        unsigned instr_base_address;
+
+	//data memory - should be initialize to all 0xFF
+	unsigned char *data_memory;
+
+	//memory size in bytes
+	unsigned data_memory_size;
+
+	//memory latency in clock cycles
+	unsigned data_memory_latency;
+
+	//statistics
+	unsigned clock_cycles;
+	unsigned stalls;
+	unsigned instructions_executed;
+	unsigned structural_stalls; //ID stalls waiting for a free execution unit
+	unsigned raw_stalls;
+	unsigned waw_stalls;
+
+	/* registers */
+	int int_registers[NUM_GP_REGISTERS];
+	float fp_registers[NUM_GP_REGISTERS];
+	unsigned sp_registers[NUM_SP_REGISTERS][NUM_STAGES];
+
+	/* pipeline latches (NOP if empty) */
+	instruction_t if_id;
+	instruction_t ex_mem;
+	instruction_t mem_wb;
+
+	/* execution units */
+	unit_t units[NUM_UNIT_TYPES][MAX_UNITS];
+	unsigned num_units[NUM_UNIT_TYPES];
+	unsigned issue_sequence;
+
+	/* scoreboard: number of instructions between ID and WB writing each register */
+	int int_pending[NUM_GP_REGISTERS];
+	int fp_pending[NUM_GP_REGISTERS];
+
+	/* control */
+	int branch_pending; //a branch is between ID and MEM: fetch waits for its outcome
+	unsigned mem_wait; //clock cycles the instruction in the MEM stage still waits for the data memory
+	int eop_issued;
+	int started; //the first instruction has been issued
+
+	//helpers
+	void release_units();
+	exe_unit_t unit_of(opcode_t opcode);
+	unit_t *free_unit(exe_unit_t type);
+	int *pending_dest(instruction_t instr);
+	int *pending_src(instruction_t instr, bool src2);
+	bool reads_fp(opcode_t opcode, bool src2);
+	bool writes_fp(opcode_t opcode);
+	bool writes_register(opcode_t opcode);
+	unsigned read_register(instruction_t instr, bool src2);
+	int issue_hazard(instruction_t instr);
+	unsigned execute(exe_slot_t *slot);
+
+public:
+
+	//instantiates the simulator with a data memory of given size (in bytes) and latency (in clock cycles)
+	sim_pipe_fp(unsigned data_mem_size, unsigned data_mem_latency);
+
+	//de-allocates the simulator
+	~sim_pipe_fp();
+
+	//adds "instances" execution units of the given type, with the given latency (additional clock cycles in the
+	//execution stage) and pipelining; the units are configuration and are not affected by reset()
+	void init_exec_unit(exe_unit_t exec_unit, unsigned latency, unsigned instances=1, bool pipelined=false);
+
+	//loads the assembly program in file "filename" in instruction memory at the specified address
+	void load_program(const char *filename, unsigned base_address=0x0);
+
+	//runs the simulator for "cycles" clock cycles (run the program to completion if cycles=0)
+	void run(unsigned cycles=0);
+
+	//resets the state of the simulator
+        /* Note:
+	   - registers should be reset to UNDEFINED value
+	   - data memory should be reset to all 0xFF values
+	*/
+	void reset();
+
+	// returns value of the specified special purpose register for a given stage (at the "entrance" of that stage)
+        // if that special purpose register is not used in that stage, returns UNDEFINED
+	// the EXE entrance holds the operands of the last instruction issued to an execution unit
+	unsigned get_sp_register(sp_register_t reg, stage_t stage);
+
+	//returns/sets the value of the specified integer register
+	int get_int_register(unsigned reg);
+	void set_int_register(unsigned reg, int value);
+
+	//returns/sets the value of the specified floating point register
+	float get_fp_register(unsigned reg);
+	void set_fp_register(unsigned reg, float value);
+
+	//returns the IPC
+	float get_IPC();
+
+	//returns the number of instructions fully executed
+	unsigned get_instructions_executed();
+
+	//returns the number of clock cycles
+	unsigned get_clock_cycles();
+
+	//returns the number of stalls: clock cycles, between the issue of the first instruction and the issue of EOP,
+	//in which no instruction leaves the ID stage
+	unsigned get_stalls();
+
+	//returns the number of ID stalls due to busy execution units / RAW hazards / WAW hazards
+	unsigned get_structural_stalls();
+	unsigned get_raw_stalls();
+	unsigned get_waw_stalls();
+
+	//prints the content of the data memory within the specified address range
+	void print_memory(unsigned start_address, unsigned end_address);
+
+	// writes an integer value to data memory at the specified address (use little-endian format: https://en.wikipedia.org/wiki/Endianness)
+	void write_memory(unsigned address, unsigned value);
+
+	//prints the values of the registers
+	void print_registers();
+
+};
+
+#endif /*SIM_PIPE_FP_H_*/
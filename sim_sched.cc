@@ -0,0 +1,235 @@
+#include "sim_sched.h"
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+/* =============================================================
+
+   LOAD-TIME LIST SCHEDULING
+
+   ============================================================= */
+
+/* in-order issue model of run() */
+typedef struct{
+	unsigned load_distance; //extra distance of the readers of a LW (non-blocking memory stage)
+	unsigned memory_freeze; //cycles a LW or SW freezes the pipeline (blocking memory stage)
+	unsigned cycle; //next issue cycle (frozen cycles excluded: they do not separate producers and readers)
+	unsigned ready[NUM_GP_REGISTERS]; //first cycle at which a reader of the register does not stall
+	unsigned stalls;
+} sched_issue_t;
+
+/* source registers read in the ID stage (as reads_register); returns their number */
+static unsigned sched_sources(const instruction_t *instr, unsigned *sources){
+	if (is_int_r(instr->opcode) || instr->opcode == SW){
+		sources[0] = instr->src1;
+		sources[1] = instr->src2;
+		return 2;
+	}
+	if (is_int_imm(instr->opcode) || instr->opcode == LW || (is_branch(instr->opcode) && instr->opcode != JUMP)){
+		sources[0] = instr->src1;
+		return 1;
+	}
+	return 0;
+}
+
+static bool sched_writes(const instruction_t *instr){
+	return (is_int_r(instr->opcode) || is_int_imm(instr->opcode) || instr->opcode == LW) && instr->dest < NUM_GP_REGISTERS;
+}
+
+/* distance (in issue cycles) at which a reader of the result of "instr" does not stall */
+static unsigned sched_distance(const sched_issue_t *s, const instruction_t *instr){
+	return SCHED_RAW_DISTANCE + (instr->opcode == LW ? s->load_distance : 0);
+}
+
+/* first cycle at which "instr" can issue without stalling */
+static unsigned sched_earliest(const sched_issue_t *s, const instruction_t *instr){
+	unsigned sources[2];
+	unsigned cycle = s->cycle;
+	unsigned n = sched_sources(instr, sources);
+	for (unsigned i=0; i<n; i++)
+		if (sources[i] < NUM_GP_REGISTERS && s->ready[sources[i]] > cycle) cycle = s->ready[sources[i]];
+	return cycle;
+}
+
+static void sched_issue(sched_issue_t *s, const instruction_t *instr){
+	unsigned cycle = sched_earliest(s, instr);
+	s->stalls += cycle - s->cycle;
+	s->cycle = cycle + 1;
+	if (sched_writes(instr)) s->ready[instr->dest] = cycle + sched_distance(s, instr);
+	if (is_memory(instr->opcode)) s->stalls += s->memory_freeze;
+	if (is_branch(instr->opcode)){
+		s->stalls += SCHED_BRANCH_BUBBLES;
+		s->cycle += SCHED_BRANCH_BUBBLES;
+	}
+}
+
+/* stalls of the basic block code[0..n) issued in "order" from the issue state "entry" */
+static unsigned sched_cost(const instruction_t *code, const vector<unsigned> &order, const sched_issue_t *entry){
+	sched_issue_t s = *entry;
+	for (unsigned k=0; k<order.size(); k++) sched_issue(&s, &code[order[k]]);
+	return s.stalls - entry->stalls;
+}
+
+/* list-schedules the basic block code[0..n) from the issue state "entry"; a closing branch or EOP stays last */
+static void sched_block(const instruction_t *code, unsigned n, const sched_issue_t *entry, vector<unsigned> &order){
+	// dependence graph (edges from earlier to later instructions), with the distance of the RAW edges
+	vector<vector<unsigned> > successors(n), distances(n);
+	vector<unsigned> predecessors(n, 0), version(n, 0);
+	for (unsigned j=0; j<n; j++)
+		for (unsigned i=0; i<j; i++)
+			if (writes_register(code[i], code[j].src1)) version[j]++;
+	bool terminator = is_branch(code[n-1].opcode) || code[n-1].opcode == EOP;
+	for (unsigned j=1; j<n; j++){
+		const instruction_t *c = &code[j];
+		for (unsigned i=0; i<j; i++){
+			const instruction_t *p = &code[i];
+			unsigned distance = 0;
+			if (sched_writes(p) && reads_register(*c, p->dest)) distance = sched_distance(entry, p);
+			else if ((sched_writes(c) && (reads_register(*p, c->dest) || writes_register(*p, c->dest))) || (terminator && j == n-1)) distance = 1;
+			else if (is_memory(p->opcode) && is_memory(c->opcode) && (p->opcode == SW || c->opcode == SW)){
+				int offset = (int) c->immediate - (int) p->immediate;
+				bool disjoint = (p->src1 == c->src1 && version[i] == version[j] && (offset >= 4 || offset <= -4));
+				if (!disjoint) distance = 1;
+			}
+			if (distance == 0) continue;
+			successors[i].push_back(j);
+			distances[i].push_back(distance);
+			predecessors[j]++;
+		}
+	}
+
+	// priority: longest path to the end of the block
+	vector<unsigned> height(n, 0);
+	for (int i=n-1; i>=0; i--)
+		for (unsigned k=0; k<successors[i].size(); k++)
+			if (distances[i][k] + height[successors[i][k]] > height[i]) height[i] = distances[i][k] + height[successors[i][k]];
+
+	// the instruction that can issue first, the highest first among them, the earliest in the program among those
+	sched_issue_t s = *entry;
+	vector<bool> scheduled(n, false);
+	order.clear();
+	for (unsigned k=0; k<n; k++){
+		int best = -1;
+		unsigned best_cycle = 0;
+		for (unsigned i=0; i<n; i++){
+			if (scheduled[i] || predecessors[i] > 0) continue;
+			unsigned cycle = sched_earliest(&s, &code[i]);
+			if (best < 0 || cycle < best_cycle || (cycle == best_cycle && height[i] > height[best])){
+				best = i;
+				best_cycle = cycle;
+			}
+		}
+		scheduled[best] = true;
+		order.push_back(best);
+		sched_issue(&s, &code[best]);
+		for (unsigned e=0; e<successors[best].size(); e++) predecessors[successors[best][e]]--;
+	}
+
+	// list scheduling is a heuristic: the original order is kept unless it is beaten
+	vector<unsigned> original(n);
+	for (unsigned i=0; i<n; i++) original[i] = i;
+	if (sched_cost(code, order, entry) >= sched_cost(code, original, entry)) order = original;
+}
+
+void sim_pipe::set_scheduling(bool enable, bool measure){
+	delete sched;
+	sched = NULL;
+	if (!enable) return;
+	sched = new sched_state_t;
+	sched->measure = measure;
+	sched_reset();
+}
+
+void sim_pipe::sched_reset(){
+	for (unsigned i=0; i<PROGRAM_SIZE; i++) sched->original[i] = instr_memory[i];
+	sched->blocks = 0;
+	sched->scheduled_blocks = 0;
+	sched->moved = 0;
+	sched->estimated_before = 0;
+	sched->estimated_after = 0;
+	sched->reference_cycles = UNDEFINED;
+	sched->reference_stalls = UNDEFINED;
+}
+
+/* reorders the basic blocks of the program just loaded (branches resolved); "leader" flags the instructions with a label */
+void sim_pipe::schedule_program(const bool *leader){
+	sched_reset();
+	unsigned length = 0;
+	while (length < PROGRAM_SIZE && instr_memory[length].opcode != EOP) length++;
+	if (length < PROGRAM_SIZE) length++; //EOP
+
+	sched_issue_t before;
+	before.load_distance = (num_mshrs > 0) ? data_memory_latency : 0;
+	before.memory_freeze = (num_mshrs > 0) ? 0 : data_memory_latency;
+	before.cycle = 0;
+	for (unsigned r=0; r<NUM_GP_REGISTERS; r++) before.ready[r] = 0;
+	before.stalls = 0;
+	sched_issue_t after = before;
+
+	const instruction_t *original = sched->original;
+	vector<unsigned> order;
+	unsigned position[PROGRAM_SIZE]; //address of each original instruction in the scheduled code
+	for (unsigned i=0; i<PROGRAM_SIZE; i++) position[i] = i;
+	unsigned first = 0;
+	for (unsigned i=0; i<length; i++){
+		opcode_t opcode = original[i].opcode;
+		if (i+1 < length && !leader[i+1] && !is_branch(opcode) && opcode != EOP) continue;
+		unsigned n = i+1 - first;
+		for (unsigned k=0; k<n; k++) sched_issue(&before, &original[first+k]);
+		sched_block(&original[first], n, &after, order);
+		unsigned moved = 0;
+		for (unsigned k=0; k<n; k++){
+			instr_memory[first+k] = original[first+order[k]];
+			position[first+order[k]] = first+k;
+			sched_issue(&after, &instr_memory[first+k]);
+			if (order[k] != k) moved++;
+		}
+		sched->blocks++;
+		if (moved > 0) sched->scheduled_blocks++;
+		sched->moved += moved;
+		first = i+1;
+	}
+
+	// branch immediates on the scheduled code: the targets are labels, i.e. the addresses of blocks, which do not move
+	for (unsigned i=0; i<length; i++){
+		if (!is_branch(original[i].opcode)) continue;
+		unsigned target = i + 1 + ((int) original[i].immediate >> 2);
+		instr_memory[position[i]].immediate = (target - position[i] - 1) << 2;
+	}
+	sched->estimated_before = before.stalls;
+	sched->estimated_after = after.stalls;
+}
+
+/* simulates the original program from the initial state, on a copy of this simulator (called by run() before the first cycle) */
+void sim_pipe::schedule_reference(){
+	// the devices are not cloned, and the translated code may have run part of the scheduled program
+	if (mmio != NULL || start_pc() != instr_base_address) return;
+	sim_pipe *sim = interval_simulator();
+	for (unsigned i=0; i<PROGRAM_SIZE; i++) sim->instr_memory[i] = sched->original[i];
+	sim->run();
+	sched->reference_cycles = sim->clock_cycles;
+	sched->reference_stalls = sim->stalls;
+	release_simulator(sim);
+}
+
+unsigned sim_pipe::get_estimated_stalls(bool scheduled){
+	if (sched == NULL) return 0;
+	return scheduled ? sched->estimated_after : sched->estimated_before;
+}
+
+unsigned sim_pipe::get_reference_cycles(){return (sched != NULL) ? sched->reference_cycles : UNDEFINED;}
+
+unsigned sim_pipe::get_reference_stalls(){return (sched != NULL) ? sched->reference_stalls : UNDEFINED;}
+
+void sim_pipe::print_schedule_stats(){
+	if (sched == NULL) return;
+	cout << dec << "scheduled blocks: " << sched->scheduled_blocks << " of " << sched->blocks << ", " << sched->moved << " instructions moved" << endl;
+	cout << "estimated stalls: " << sched->estimated_before << " -> " << sched->estimated_after
+	     << " (" << (int) (sched->estimated_before - sched->estimated_after) << " fewer)" << endl;
+	if (sched->reference_cycles != UNDEFINED && clock_cycles > 0){
+		cout << "measured: cycles " << sched->reference_cycles << " -> " << clock_cycles << ", stalls " << sched->reference_stalls << " -> " << stalls
+		     << " (" << (int) (sched->reference_cycles - clock_cycles) << " fewer stall cycles)" << endl;
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef SIM_SCHED_H_
+#define SIM_SCHED_H_
+
+#include "sim_pipe.h"
+
+using namespace std;
+
+/*
+Load-time list scheduling (sim_pipe::set_scheduling).
+
+Once the labels of a program are resolved, load_program reorders the instructions of each basic block (from a
+label or the instruction following a branch to the next branch, label or EOP), then resolves the branch
+immediates again on the scheduled code (the blocks keep their addresses and a closing branch stays last, so the
+labels still mark the same blocks). The reordering keeps the register dependences (RAW, WAR, WAW)
+and the order of the memory accesses that may overlap: two accesses with the same base register, not
+redefined in between, and disjoint words are independent; the others keep their order.
+
+The cost model is the one of run(), with one instruction issued per cycle in program order:
+- the ID stage stalls an instruction until its producers have left the MEM stage, i.e. until SCHED_RAW_DISTANCE
+  cycles after they were issued (plus the data memory latency for a LW with a non-blocking memory stage);
+- every LW and SW freezes the pipeline for the data memory latency (blocking memory stage);
+- every branch inserts SCHED_BRANCH_BUBBLES bubbles.
+The blocks are scheduled by decreasing height (longest latency-weighted path to the end of the block) among the
+instructions that can issue first, starting from the register state left by the previous block when it falls
+through. A block keeps its original order unless the schedule has fewer estimated stalls.
+
+The estimated stalls count one execution of every block, in program order; the measured ones need a reference
+simulation of the original program from the same initial state, done by run() if requested.
+*/
+
+#define SCHED_RAW_DISTANCE 3
+#define SCHED_BRANCH_BUBBLES 2
+
+typedef struct sched_state{
+	//configuration
+	int measure; //simulate the original program at the beginning of run()
+
+	//last program loaded
+	instruction_t original[PROGRAM_SIZE];
+	unsigned blocks;
+	unsigned scheduled_blocks; //blocks whose order changed
+	unsigned moved; //instructions not at their original address
+	unsigned estimated_before; //stall cycles
+	unsigned estimated_after;
+
+	//simulation of the original program (UNDEFINED if not measured)
+	unsigned reference_cycles;
+	unsigned reference_stalls;
+} sched_state_t;
+
+#endif /*SIM_SCHED_H_*/
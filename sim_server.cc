@@ -0,0 +1,456 @@
+#include "sim_pipe.h"
+#include "result_cache.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <thread>
+#include <mutex>
+
+using namespace std;
+
+/* =============================================================
+
+   SIMULATION SERVER
+
+   ============================================================= */
+
+/*
+Long-lived simulation daemon: accepts jobs over a Unix-domain stream socket and runs them on a pool of worker
+threads, reusing pre-allocated simulators and decoded programs across jobs.
+
+	sim_server [-w workers] [-p programs] socket
+
+-w workers	worker threads (default: number of processors); each one serves one connection at a time
+-p programs	decoded programs kept in the cache (default 256)
+
+Protocol (text, one request per line, numbers in decimal or 0x hex). A connection carries any number of jobs,
+which are run in order; clients wanting parallelism open several connections.
+
+	job <id>
+	config <memory size> <memory latency> [<mshrs> [<store buffer entries>]]	(default 4096 0 0 0)
+	cycles <budget>								(default 0 = run to completion)
+	reg <register> <value>							(initial general purpose registers)
+	mem <address> <value>							(initial data memory words, as write_memory)
+	dump <start address> <end address>					(data memory returned with the results)
+	program <lines> [<base address>]
+	<lines lines of assembly, as accepted by sim_pipe::load_program>
+	end
+
+The results of a job are sent back as soon as it completes:
+
+	result <id> cycles <clock cycles> instructions <instructions executed> stalls <stalls>
+	regs <R0> ... <R31>
+	dump <start address> <end address> <bytes in hex>			(one per dump request)
+	done <id>
+
+A malformed job is answered by "error <id> <reason>" and the connection is closed. The program itself is run as by
+sim_pipe::run(), which does not check its addresses: the socket must only be accessible to trusted clients, and a
+program without EOP needs a cycle budget.
+
+Simulators are pooled by configuration: a job resets one that is idle instead of constructing it. Programs are
+cached by content and base address: a cached program is copied into the instruction memory instead of parsed.
+*/
+
+#define DEFAULT_MEMORY_SIZE 4096
+#define MAX_MEMORY_SIZE (1U << 30)
+#define MAX_JOB_REQUESTS 65536 //reg/mem/dump requests per job
+
+typedef struct{
+	unsigned memory_size;
+	unsigned memory_latency;
+	unsigned mshrs;
+	unsigned store_buffer;
+} job_config_t;
+
+static bool operator<(const job_config_t &a, const job_config_t &b){
+	if (a.memory_size != b.memory_size) return a.memory_size < b.memory_size;
+	if (a.memory_latency != b.memory_latency) return a.memory_latency < b.memory_latency;
+	if (a.mshrs != b.mshrs) return a.mshrs < b.mshrs;
+	return a.store_buffer < b.store_buffer;
+}
+
+typedef struct{
+	string id;
+	job_config_t config;
+	unsigned cycles;
+	vector<pair<unsigned, unsigned> > registers; //register, value
+	vector<pair<unsigned, unsigned> > words; //address, value
+	vector<pair<unsigned, unsigned> > dumps; //start, end
+	string program;
+	unsigned program_lines;
+	unsigned base_address;
+} job_t;
+
+/* decoded program: the instruction memory after load_program (the instructions past program_lines are NOPs) */
+typedef struct{
+	vector<instruction_t> instructions;
+	unsigned base_address;
+} decoded_program_t;
+
+class sim_server{
+
+	/* simulators not running a job, by configuration */
+	map<job_config_t, vector<sim_pipe *> > pool;
+	mutex pool_lock;
+
+	/* decoded programs by key, and keys from the least to the most recently used */
+	map<pair<unsigned long long, unsigned long long>, decoded_program_t> programs;
+	list<pair<unsigned long long, unsigned long long> > program_order;
+	unsigned max_programs;
+	mutex program_lock;
+
+	sim_pipe *acquire(const job_config_t &config);
+	void release(const job_config_t &config, sim_pipe *sim);
+	void install_program(sim_pipe *sim, const job_t &job);
+	void run_job(const job_t &job, string *reply);
+
+public:
+
+	sim_server(unsigned max_programs);
+	~sim_server();
+
+	//serves the jobs of a connection until the client closes it
+	void serve(int fd);
+};
+
+sim_server::sim_server(unsigned max_programs){
+	this->max_programs = max_programs;
+}
+
+sim_server::~sim_server(){
+	for (map<job_config_t, vector<sim_pipe *> >::iterator it=pool.begin(); it!=pool.end(); it++)
+		for (unsigned i=0; i<it->second.size(); i++) delete it->second[i];
+}
+
+/* takes an idle simulator with the given configuration out of the pool, or constructs one */
+sim_pipe *sim_server::acquire(const job_config_t &config){
+	{
+		unique_lock<mutex> l(pool_lock);
+		vector<sim_pipe *> &idle = pool[config];
+		if (!idle.empty()){
+			sim_pipe *sim = idle.back();
+			idle.pop_back();
+			return sim;
+		}
+	}
+	sim_pipe *sim = new sim_pipe(config.memory_size, config.memory_latency);
+	if (config.mshrs > 0) sim->set_mshrs(config.mshrs);
+	if (config.store_buffer > 0) sim->set_store_buffer(config.store_buffer);
+	return sim;
+}
+
+void sim_server::release(const job_config_t &config, sim_pipe *sim){
+	unique_lock<mutex> l(pool_lock);
+	pool[config].push_back(sim);
+}
+
+/* loads the program of the job in the (reset) simulator, decoding it only if it is not in the cache */
+void sim_server::install_program(sim_pipe *sim, const job_t &job){
+	result_key_t key;
+	result_key_init(&key);
+	result_key_update(&key, &job.base_address, sizeof job.base_address);
+	result_key_update(&key, job.program.data(), job.program.size());
+	pair<unsigned long long, unsigned long long> k(key.h1, key.h2);
+	{
+		unique_lock<mutex> l(program_lock);
+		map<pair<unsigned long long, unsigned long long>, decoded_program_t>::iterator it = programs.find(k);
+		if (it != programs.end()){
+			for (unsigned i=0; i<it->second.instructions.size(); i++) sim->instr_memory[i] = it->second.instructions[i];
+			sim->instr_base_address = it->second.base_address;
+			program_order.remove(k);
+			program_order.push_back(k);
+			return;
+		}
+	}
+	istringstream in(job.program);
+	sim->load_program(in, job.base_address);
+
+	decoded_program_t decoded;
+	decoded.instructions.assign(sim->instr_memory, sim->instr_memory + job.program_lines);
+	decoded.base_address = sim->instr_base_address;
+	unique_lock<mutex> l(program_lock);
+	if (max_programs == 0 || programs.find(k) != programs.end()) return;
+	if (programs.size() == max_programs){
+		programs.erase(program_order.front());
+		program_order.pop_front();
+	}
+	programs[k] = decoded;
+	program_order.push_back(k);
+}
+
+void sim_server::run_job(const job_t &job, string *reply){
+	sim_pipe *sim = acquire(job.config);
+	sim->reset();
+	install_program(sim, job);
+	for (unsigned i=0; i<job.registers.size(); i++) sim->set_gp_register(job.registers[i].first, job.registers[i].second);
+	for (unsigned i=0; i<job.words.size(); i++) sim->write_memory(job.words[i].first, job.words[i].second);
+	sim->run(job.cycles);
+
+	ostringstream out;
+	out << "result " << job.id << " cycles " << sim->get_clock_cycles() << " instructions " << sim->get_instructions_executed()
+	    << " stalls " << sim->get_stalls() << "\n";
+	out << "regs";
+	for (unsigned i=0; i<NUM_GP_REGISTERS; i++) out << " " << sim->get_gp_register(i);
+	out << "\n";
+	static const char digits[] = "0123456789abcdef";
+	for (unsigned d=0; d<job.dumps.size(); d++){
+		out << "dump " << job.dumps[d].first << " " << job.dumps[d].second << " ";
+		string bytes;
+		for (unsigned a=job.dumps[d].first; a<job.dumps[d].second; a++){
+			bytes += digits[sim->data_memory[a] >> 4];
+			bytes += digits[sim->data_memory[a] & 0xF];
+		}
+		out << bytes << "\n";
+	}
+	out << "done " << job.id << "\n";
+	*reply = out.str();
+	release(job.config, sim);
+}
+
+/* =============================================================
+
+   REQUEST PARSING
+
+   ============================================================= */
+
+/* line reader over a socket */
+class connection{
+	int fd;
+	char buffer[65536];
+	unsigned begin;
+	unsigned end;
+public:
+	connection(int fd) : fd(fd), begin(0), end(0) {}
+
+	//reads the next line (without the newline); returns false at the end of the stream
+	bool read_line(string *line){
+		line->clear();
+		while (1){
+			for (unsigned i=begin; i<end; i++){
+				if (buffer[i] == '\n'){
+					line->append(buffer + begin, i - begin);
+					begin = i + 1;
+					if (!line->empty() && (*line)[line->size()-1] == '\r') line->erase(line->size()-1);
+					return true;
+				}
+			}
+			line->append(buffer + begin, end - begin);
+			begin = end = 0;
+			ssize_t n = read(fd, buffer, sizeof buffer);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return !line->empty();
+			end = n;
+		}
+	}
+
+	//writes "text"; returns false if the client is gone
+	bool write_all(const string &text){
+		unsigned written = 0;
+		while (written < text.size()){
+			ssize_t n = write(fd, text.data() + written, text.size() - written);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			written += n;
+		}
+		return true;
+	}
+};
+
+static bool parse_number(const string &token, unsigned *value){
+	if (token.empty() || token[0] == '-') return false;
+	char *end;
+	errno = 0;
+	unsigned long v = strtoul(token.c_str(), &end, 0);
+	if (*end != '\0' || errno != 0 || v > 0xFFFFFFFFUL) return false;
+	*value = v;
+	return true;
+}
+
+/* checks the tokens that sim_pipe::load_program relies on: the opcode (after an optional label) and the number of operands */
+static bool valid_instruction(const string &line){
+	istringstream in(line);
+	vector<string> tokens;
+	string token;
+	while (in >> token) tokens.push_back(token);
+	unsigned first = 0;
+	int opcode = -1;
+	for (unsigned pass=0; pass<2 && opcode < 0 && first < tokens.size(); pass++){
+		for (int o=0; o<NUM_OPCODES; o++)
+			if (tokens[first] == opcode_name((opcode_t) o)) opcode = o;
+		if (opcode < 0){
+			if (pass == 1 || tokens[first][tokens[first].size()-1] != ':') return false;
+			first++;
+		}
+	}
+	if (opcode < 0) return false;
+	unsigned operands = tokens.size() - first - 1;
+	switch((opcode_t) opcode){
+		case ADD: case SUB: case XOR: case ADDI: case SUBI:
+			return operands >= 3;
+		case LW: case SW:
+			return operands >= 2 && tokens[first+2].find('(') != string::npos;
+		case BEQZ: case BNEZ: case BLTZ: case BGTZ: case BLEZ: case BGEZ:
+			return operands >= 2;
+		case JUMP:
+			return operands >= 1;
+		default:
+			return true;
+	}
+}
+
+/* reads the requests of a job after its "job" line; returns an error message, or an empty string if the job is valid */
+static string read_job(connection *conn, job_t *job){
+	job->config.memory_size = DEFAULT_MEMORY_SIZE;
+	job->config.memory_latency = 0;
+	job->config.mshrs = 0;
+	job->config.store_buffer = 0;
+	job->cycles = 0;
+	job->program_lines = 0;
+	job->base_address = 0;
+	bool has_program = false;
+	unsigned requests = 0;
+	string line;
+	while (conn->read_line(&line)){
+		istringstream in(line);
+		string request;
+		vector<string> args;
+		string arg;
+		in >> request;
+		while (in >> arg) args.push_back(arg);
+		vector<unsigned> values(args.size());
+		for (unsigned i=0; i<args.size(); i++)
+			if (!parse_number(args[i], &values[i])) return "invalid number " + args[i];
+
+		if (request.empty()) continue;
+		else if (request == "end"){
+			if (!has_program) return "no program";
+			for (unsigned i=0; i<job->words.size(); i++)
+				if (job->config.memory_size < 4 || job->words[i].first > job->config.memory_size - 4) return "mem outside the data memory";
+			for (unsigned i=0; i<job->dumps.size(); i++)
+				if (job->dumps[i].first > job->dumps[i].second || job->dumps[i].second > job->config.memory_size) return "dump outside the data memory";
+			return "";
+		} else if (++requests > MAX_JOB_REQUESTS){
+			return "too many requests";
+		} else if (request == "config" && values.size() >= 2 && values.size() <= 4){
+			values.resize(4, 0);
+			if (values[0] == 0 || values[0] > MAX_MEMORY_SIZE) return "invalid memory size";
+			if (values[3] == 1) return "the store buffer needs at least 2 entries";
+			job->config.memory_size = values[0];
+			job->config.memory_latency = values[1];
+			job->config.mshrs = values[2];
+			job->config.store_buffer = values[3];
+		} else if (request == "cycles" && values.size() == 1){
+			job->cycles = values[0];
+		} else if (request == "reg" && values.size() == 2){
+			if (values[0] >= NUM_GP_REGISTERS) return "invalid register " + args[0];
+			job->registers.push_back(make_pair(values[0], values[1]));
+		} else if (request == "mem" && values.size() == 2){
+			job->words.push_back(make_pair(values[0], values[1]));
+		} else if (request == "dump" && values.size() == 2){
+			job->dumps.push_back(make_pair(values[0], values[1]));
+		} else if (request == "program" && (values.size() == 1 || values.size() == 2) && !has_program){
+			if (values[0] == 0 || values[0] > PROGRAM_SIZE) return "invalid program size";
+			job->program_lines = values[0];
+			if (values.size() == 2) job->base_address = values[1];
+			for (unsigned i=0; i<job->program_lines; i++){
+				if (!conn->read_line(&line)) return "truncated program";
+				if (!valid_instruction(line)) return "invalid instruction: " + line;
+				job->program += line;
+				job->program += '\n';
+			}
+			has_program = true;
+		} else {
+			return "invalid request: " + line;
+		}
+	}
+	return "truncated job";
+}
+
+void sim_server::serve(int fd){
+	connection conn(fd);
+	string line;
+	while (conn.read_line(&line)){
+		istringstream in(line);
+		string request;
+		job_t job;
+		in >> request >> job.id;
+		if (request.empty()) continue;
+		if (request != "job" || job.id.empty()){
+			conn.write_all("error - expected a job\n");
+			return;
+		}
+		string error = read_job(&conn, &job);
+		if (!error.empty()){
+			conn.write_all("error " + job.id + " " + error + "\n");
+			return;
+		}
+		string reply;
+		run_job(job, &reply);
+		if (!conn.write_all(reply)) return;
+	}
+}
+
+static void usage(){
+	cerr << "usage: sim_server [-w workers] [-p programs] socket" << endl;
+	exit(-1);
+}
+
+int main(int argc, char **argv){
+	unsigned workers = thread::hardware_concurrency();
+	unsigned max_programs = 256;
+	int opt;
+	while ((opt = getopt(argc, argv, "w:p:")) != -1){
+		switch(opt){
+			case 'w': workers = strtoul(optarg, NULL, 0); break;
+			case 'p': max_programs = strtoul(optarg, NULL, 0); break;
+			default: usage();
+		}
+	}
+	if (optind != argc-1) usage();
+	if (workers == 0) workers = 1;
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof address);
+	address.sun_family = AF_UNIX;
+	if (strlen(argv[optind]) >= sizeof address.sun_path){
+		cerr << "error: socket path " << argv[optind] << " is too long" << endl;
+		exit(-1);
+	}
+	strcpy(address.sun_path, argv[optind]);
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(argv[optind]);
+	if (listener < 0 || bind(listener, (struct sockaddr *) &address, sizeof address) != 0 || listen(listener, 128) != 0){
+		cerr << "error: listening on socket " << argv[optind] << " failed: " << strerror(errno) << endl;
+		exit(-1);
+	}
+	signal(SIGPIPE, SIG_IGN); //a client closing its connection early must not terminate the server
+
+	// every worker accepts and serves connections on its own
+	sim_server server(max_programs);
+	vector<thread> pool;
+	for (unsigned w=0; w<workers; w++)
+		pool.push_back(thread([&server, listener](){
+			while (1){
+				int fd = accept(listener, NULL, NULL);
+				if (fd < 0){
+					if (errno == EINTR || errno == ECONNABORTED) continue;
+					cerr << "error: accept failed: " << strerror(errno) << endl;
+					exit(-1);
+				}
+				server.serve(fd);
+				close(fd);
+			}
+		}));
+	for (unsigned w=0; w<workers; w++) pool[w].join();
+	return 0;
+}
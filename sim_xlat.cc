@@ -0,0 +1,190 @@
+#include "sim_xlat.h"
+#include <stdlib.h>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/* =============================================================
+
+   BASIC BLOCK TRANSLATOR
+
+   ============================================================= */
+
+/* operation handlers: the arithmetic is the one of alu() and taken_branch(), on the operands decoded at translation */
+
+static int xlat_add(xlat_context_t *c, const xlat_op_t *op){
+	c->gp_registers[op->dest] = (unsigned) c->gp_registers[op->src1] + (unsigned) c->gp_registers[op->src2];
+	return XLAT_NEXT;
+}
+
+static int xlat_sub(xlat_context_t *c, const xlat_op_t *op){
+	c->gp_registers[op->dest] = (unsigned) c->gp_registers[op->src1] - (unsigned) c->gp_registers[op->src2];
+	return XLAT_NEXT;
+}
+
+static int xlat_xor(xlat_context_t *c, const xlat_op_t *op){
+	c->gp_registers[op->dest] = c->gp_registers[op->src1] ^ c->gp_registers[op->src2];
+	return XLAT_NEXT;
+}
+
+/* ADDI, and SUBI with the immediate negated */
+static int xlat_addi(xlat_context_t *c, const xlat_op_t *op){
+	c->gp_registers[op->dest] = (unsigned) c->gp_registers[op->src1] + op->immediate;
+	return XLAT_NEXT;
+}
+
+static int xlat_lw(xlat_context_t *c, const xlat_op_t *op){
+	unsigned address = (unsigned) c->gp_registers[op->src1] + op->immediate;
+	if (c->data_memory_size < 4 || address > c->data_memory_size - 4) return XLAT_FAULT;
+	c->gp_registers[op->dest] = load_word(&c->data_memory[address]);
+	return XLAT_NEXT;
+}
+
+static int xlat_sw(xlat_context_t *c, const xlat_op_t *op){
+	unsigned address = (unsigned) c->gp_registers[op->src1] + op->immediate;
+	if (c->data_memory_size < 4 || address > c->data_memory_size - 4) return XLAT_FAULT;
+	unsigned value = c->gp_registers[op->src2];
+	memcpy(&c->data_memory[address], &value, sizeof value); //same layout as load_word
+	return XLAT_NEXT;
+}
+
+static int xlat_beqz(xlat_context_t *c, const xlat_op_t *op){return (c->gp_registers[op->src1] == 0) ? XLAT_TAKEN : XLAT_NEXT;}
+static int xlat_bnez(xlat_context_t *c, const xlat_op_t *op){return (c->gp_registers[op->src1] != 0) ? XLAT_TAKEN : XLAT_NEXT;}
+static int xlat_bltz(xlat_context_t *c, const xlat_op_t *op){return (c->gp_registers[op->src1] < 0) ? XLAT_TAKEN : XLAT_NEXT;}
+static int xlat_bgtz(xlat_context_t *c, const xlat_op_t *op){return (c->gp_registers[op->src1] > 0) ? XLAT_TAKEN : XLAT_NEXT;}
+static int xlat_blez(xlat_context_t *c, const xlat_op_t *op){return (c->gp_registers[op->src1] <= 0) ? XLAT_TAKEN : XLAT_NEXT;}
+static int xlat_bgez(xlat_context_t *c, const xlat_op_t *op){return (c->gp_registers[op->src1] >= 0) ? XLAT_TAKEN : XLAT_NEXT;}
+static int xlat_jump(xlat_context_t *c, const xlat_op_t *op){return XLAT_TAKEN;}
+
+/* returns the handler executing "opcode" (NULL if it ends the translated code: EOP, NOP) */
+static xlat_handler_t xlat_handler(opcode_t opcode){
+	switch(opcode){
+		case ADD: return xlat_add;
+		case SUB: return xlat_sub;
+		case XOR: return xlat_xor;
+		case ADDI:
+		case SUBI: return xlat_addi;
+		case LW: return xlat_lw;
+		case SW: return xlat_sw;
+		case BEQZ: return xlat_beqz;
+		case BNEZ: return xlat_bnez;
+		case BLTZ: return xlat_bltz;
+		case BGTZ: return xlat_bgtz;
+		case BLEZ: return xlat_blez;
+		case BGEZ: return xlat_bgez;
+		case JUMP: return xlat_jump;
+		default: return NULL;
+	}
+}
+
+/* flushes the translation cache and restarts from the beginning of the program */
+void sim_pipe::xlat_reset(){
+	for (unsigned i=0; i<PROGRAM_SIZE; i++){
+		delete xlat->blocks[i];
+		xlat->blocks[i] = NULL;
+	}
+	xlat->pc = UNDEFINED;
+	xlat->instructions = 0;
+	xlat->translated = 0;
+	xlat->chained = 0;
+}
+
+/* address of the first instruction of the timing models: the next one of the translated code, if it has run */
+unsigned sim_pipe::start_pc(){
+	return (xlat != NULL && xlat->pc != UNDEFINED) ? xlat->pc : instr_base_address;
+}
+
+/* sets the next instruction to execute (UNDEFINED: the start of the program), allocating the translator state */
+void sim_pipe::xlat_start(unsigned pc){
+	if (xlat == NULL){
+		xlat = new xlat_state_t;
+		for (unsigned i=0; i<PROGRAM_SIZE; i++) xlat->blocks[i] = NULL;
+		xlat_reset();
+	}
+	xlat->pc = pc;
+}
+
+/* returns the block starting at "pc", translating it if it is not in the cache (NULL if there is no instruction to execute at "pc") */
+xlat_block_t *sim_pipe::xlat_translate(unsigned pc){
+	unsigned index = (pc - instr_base_address)/4;
+	if (pc < instr_base_address || (pc - instr_base_address)%4 != 0 || index >= PROGRAM_SIZE) return NULL;
+	if (xlat->blocks[index] != NULL) return xlat->blocks[index];
+	if (xlat_handler(instr_memory[index].opcode) == NULL) return NULL;
+
+	xlat_block_t *block = new xlat_block_t;
+	block->pc = pc;
+	block->exit_pc[1] = UNDEFINED;
+	block->chain[0] = block->chain[1] = NULL;
+	unsigned i = index;
+	while (i < PROGRAM_SIZE && block->ops.size() < XLAT_MAX_BLOCK){
+		instruction_t *instr = &instr_memory[i];
+		xlat_op_t op;
+		op.handler = xlat_handler(instr->opcode);
+		if (op.handler == NULL) break;
+		op.dest = instr->dest;
+		op.src1 = instr->src1;
+		op.src2 = instr->src2;
+		op.immediate = (instr->opcode == SUBI) ? -instr->immediate : instr->immediate;
+		block->ops.push_back(op);
+		i++;
+		if (is_branch(instr->opcode)){
+			block->exit_pc[1] = alu(instr->opcode, 0, 0, instr->immediate, instr_base_address + 4*i);
+			break;
+		}
+	}
+	block->exit_pc[0] = instr_base_address + 4*i;
+	xlat->blocks[index] = block;
+	xlat->translated++;
+	return block;
+}
+
+void sim_pipe::run_translated(unsigned instructions){
+	if (clock_cycles != 0){
+		cerr << "error: run_translated() can only run before the first clock cycle of the timing models" << endl;
+		exit(-1);
+	}
+	if (mmio != NULL){
+		cerr << "error: run_translated() does not support memory-mapped devices" << endl;
+		exit(-1);
+	}
+	if (xlat == NULL) xlat_start(UNDEFINED);
+
+	xlat_context_t context = {gp_registers, data_memory, data_memory_size};
+	unsigned pc = start_pc();
+	unsigned long long executed = 0;
+	xlat_block_t *block = xlat_translate(pc);
+	while (block != NULL){
+		unsigned n;
+		int result = XLAT_NEXT;
+		for (n=0; n<block->ops.size(); n++){
+			result = block->ops[n].handler(&context, &block->ops[n]);
+			if (result != XLAT_NEXT) break;
+		}
+		if (result == XLAT_FAULT){
+			// stop in front of the faulting access
+			executed += n;
+			pc = block->pc + 4*n;
+			break;
+		}
+		int exit = (result == XLAT_TAKEN);
+		executed += exit ? n+1 : n;
+		pc = block->exit_pc[exit];
+		if (instructions != 0 && executed >= instructions) break;
+		if (block->chain[exit] != NULL){
+			xlat->chained++;
+			block = block->chain[exit];
+		} else {
+			block->chain[exit] = xlat_translate(pc);
+			block = block->chain[exit];
+		}
+	}
+	xlat->pc = pc;
+	xlat->instructions += executed;
+}
+
+unsigned long long sim_pipe::get_translated_instructions(){return (xlat != NULL) ? xlat->instructions : 0;}
+
+unsigned sim_pipe::get_translated_blocks(){return (xlat != NULL) ? xlat->translated : 0;}
+
+unsigned long long sim_pipe::get_chained_exits(){return (xlat != NULL) ? xlat->chained : 0;}
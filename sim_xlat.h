@@ -0,0 +1,67 @@
+#ifndef SIM_XLAT_H_
+#define SIM_XLAT_H_
+
+#include "sim_pipe.h"
+#include <vector>
+
+using namespace std;
+
+/*
+State of the basic block translator (sim_pipe::run_translated).
+
+A basic block starts at the target of a branch (or at the first instruction executed) and ends with a branch,
+before an EOP or after XLAT_MAX_BLOCK instructions. It is translated once, when first entered, into a chain of
+operations: each one is a handler specialized for the opcode (SUBI is folded into ADDI) and the decoded
+operands, so that executing it involves no decoding and no switch on the opcode; branch targets are resolved
+at translation. The translation cache holds the block starting at every instruction of the program.
+Each block keeps direct links to the blocks of its two successors (fall through and taken branch), filled in
+the first time the exit is followed, so that the cache is only searched once per exit.
+
+Translated code reads and writes gp_registers and data_memory directly: at every block boundary the
+architectural state is the one of a sequential execution, and run() (or the other timing models) can take
+over from the next instruction.
+*/
+
+#define XLAT_MAX_BLOCK 64 //instructions
+
+typedef struct xlat_context{
+	int *gp_registers;
+	unsigned char *data_memory;
+	unsigned data_memory_size;
+} xlat_context_t;
+
+struct xlat_op;
+
+/* executes an operation; returns one of the XLAT_ results */
+typedef int (*xlat_handler_t)(xlat_context_t *context, const struct xlat_op *op);
+
+#define XLAT_NEXT 0 //continue with the next operation (or fall through at the end of the block)
+#define XLAT_TAKEN 1 //taken branch: leave the block to the branch target
+#define XLAT_FAULT 2 //access outside the data memory: the operation has not been executed
+
+typedef struct xlat_op{
+	xlat_handler_t handler;
+	unsigned dest;
+	unsigned src1;
+	unsigned src2;
+	unsigned immediate;
+} xlat_op_t;
+
+typedef struct xlat_block{
+	unsigned pc; //address of the first instruction
+	vector<xlat_op_t> ops;
+	unsigned exit_pc[2]; //next instruction after falling through / after the taken branch (UNDEFINED: none)
+	struct xlat_block *chain[2]; //translated successors (NULL until the exit is first followed)
+} xlat_block_t;
+
+typedef struct xlat_state{
+	xlat_block_t *blocks[PROGRAM_SIZE]; //translation cache, by index of the first instruction
+	unsigned pc; //next instruction to execute (UNDEFINED: the start of the program)
+
+	//statistics
+	unsigned long long instructions; //instructions executed by translated code
+	unsigned translated; //blocks translated
+	unsigned long long chained; //block exits that followed a direct link
+} xlat_state_t;
+
+#endif /*SIM_XLAT_H_*/
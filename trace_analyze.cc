@@ -0,0 +1,168 @@
+#include "mem_trace.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+/* =============================================================
+
+   MEMORY TRACE ANALYZER
+
+   ============================================================= */
+
+/*
+Reads a trace written by sim_pipe::set_mem_trace and prints, in a single pass over it:
+- the reuse distance histogram: for each access, the number of distinct lines accessed since the previous access
+  to the same line (cold accesses have no previous one);
+- the working set over time: distinct lines accessed in each window of consecutive accesses;
+- the miss ratio curve of fully associative LRU caches of any size, derived from the histogram (an access
+  misses in a cache of C lines if and only if it is cold or its reuse distance is at least C).
+
+	trace_analyze [-l line] [-w window] [-c bytes]... file
+
+-l line		line size in bytes (default 32)
+-w window	accesses per working set window (default 1000)
+-c bytes	cache size of a point of the miss ratio curve (can be repeated); by default the curve is printed
+		for all the powers of two (in lines) up to the number of distinct lines
+*/
+
+/* Fenwick tree over the positions of the accesses: 1 at the last access to each line */
+class fenwick{
+	vector<int> tree;
+public:
+	fenwick(unsigned size) : tree(size + 1, 0) {}
+	void add(unsigned position, int value){
+		for (unsigned i=position; i<tree.size(); i += i & (~i + 1)) tree[i] += value;
+	}
+	unsigned sum(unsigned position){
+		int s = 0;
+		for (unsigned i=position; i>0; i -= i & (~i + 1)) s += tree[i];
+		return s;
+	}
+};
+
+static void usage(){
+	cerr << "usage: trace_analyze [-l line] [-w window] [-c bytes]... file" << endl;
+	exit(-1);
+}
+
+int main(int argc, char **argv){
+	unsigned line_size = 32;
+	unsigned window = 1000;
+	vector<unsigned> sizes; //additional cache sizes (bytes)
+	int opt;
+	while ((opt = getopt(argc, argv, "l:w:c:")) != -1){
+		switch(opt){
+			case 'l': line_size = strtoul(optarg, NULL, 0); break;
+			case 'w': window = strtoul(optarg, NULL, 0); break;
+			case 'c': sizes.push_back(strtoul(optarg, NULL, 0)); break;
+			default: usage();
+		}
+	}
+	if (optind != argc-1 || line_size == 0 || window == 0) usage();
+
+	FILE *file = fopen(argv[optind], "rb");
+	if (file == NULL){
+		cerr << "error: open file " << argv[optind] << " failed!" << endl;
+		exit(-1);
+	}
+	char magic[sizeof MEM_TRACE_MAGIC];
+	if (fread(magic, 1, strlen(MEM_TRACE_MAGIC), file) != strlen(MEM_TRACE_MAGIC) || memcmp(magic, MEM_TRACE_MAGIC, strlen(MEM_TRACE_MAGIC)) != 0){
+		cerr << "error: " << argv[optind] << " is not a memory trace" << endl;
+		exit(-1);
+	}
+	fseek(file, 0, SEEK_END);
+	unsigned records = (ftell(file) - strlen(MEM_TRACE_MAGIC)) / MEM_TRACE_RECORD_SIZE;
+	fseek(file, strlen(MEM_TRACE_MAGIC), SEEK_SET);
+
+	fenwick marks(records);
+	map<unsigned, unsigned> last_access; //line -> position (1-based) of its last access
+	vector<unsigned long long> histogram; //accesses per reuse distance
+	unsigned long long cold = 0, reads = 0, writes = 0;
+	map<unsigned, unsigned> last_window; //line -> last window it was accessed in
+	vector<unsigned> working_set;
+	vector<unsigned> window_cycle; //clock cycle of the first access of each window
+
+	vector<unsigned char> buffer(MEM_TRACE_BUFFER_RECORDS * MEM_TRACE_RECORD_SIZE);
+	unsigned position = 0;
+	unsigned n;
+	while ((n = fread(&buffer[0], MEM_TRACE_RECORD_SIZE, MEM_TRACE_BUFFER_RECORDS, file)) > 0){
+		for (unsigned r=0; r<n; r++){
+			mem_trace_record_t record;
+			mem_trace_decode(&buffer[r * MEM_TRACE_RECORD_SIZE], &record);
+			if (record.write) writes++;
+			else reads++;
+			unsigned line = record.address / line_size;
+			position++;
+
+			// reuse distance: distinct lines whose last access follows the previous access to this line
+			map<unsigned, unsigned>::iterator last = last_access.find(line);
+			if (last == last_access.end()){
+				cold++;
+				last_access[line] = position;
+			} else {
+				unsigned distance = marks.sum(position-1) - marks.sum(last->second);
+				if (distance >= histogram.size()) histogram.resize(distance + 1, 0);
+				histogram[distance]++;
+				marks.add(last->second, -1);
+				last->second = position;
+			}
+			marks.add(position, 1);
+
+			// working set of the current window
+			unsigned w = (position-1) / window;
+			if (w == working_set.size()){
+				working_set.push_back(0);
+				window_cycle.push_back(record.cycle);
+			}
+			map<unsigned, unsigned>::iterator seen = last_window.find(line);
+			if (seen == last_window.end() || seen->second != w){
+				last_window[line] = w;
+				working_set[w]++;
+			}
+		}
+	}
+	fclose(file);
+
+	unsigned long long accesses = reads + writes;
+	cout << "accesses " << accesses << " (LW " << reads << ", SW " << writes << "), distinct lines " << last_access.size() << " of " << line_size << " bytes" << endl;
+	if (accesses == 0) return 0;
+
+	cout << endl << "reuse distance (lines)   accesses" << endl;
+	cout << setw(22) << "cold" << "   " << cold << endl;
+	for (unsigned low=0; low<histogram.size(); low = (low == 0) ? 1 : 2*low){
+		unsigned high = (low == 0) ? 0 : 2*low - 1;
+		unsigned long long count = 0;
+		for (unsigned d=low; d<=high && d<histogram.size(); d++) count += histogram[d];
+		ostringstream range;
+		if (low == high) range << low;
+		else range << low << "-" << high;
+		cout << setw(22) << range.str() << "   " << count << endl;
+	}
+
+	cout << endl << "working set (window of " << window << " accesses)" << endl;
+	for (unsigned w=0; w<working_set.size(); w++)
+		cout << "cycle " << setw(10) << window_cycle[w] << "   " << working_set[w] << " lines" << endl;
+
+	// misses of a cache of C lines: cold accesses plus accesses with reuse distance >= C
+	vector<unsigned long long> at_least(histogram.size() + 1, 0);
+	for (int d=histogram.size()-1; d>=0; d--) at_least[d] = at_least[d+1] + histogram[d];
+	if (sizes.empty())
+		for (unsigned lines=1; ; lines *= 2){
+			sizes.push_back(lines * line_size);
+			if (lines >= last_access.size()) break;
+		}
+	cout << endl << "miss ratio curve (fully associative LRU)" << endl;
+	for (unsigned i=0; i<sizes.size(); i++){
+		unsigned lines = sizes[i] / line_size;
+		unsigned long long misses = cold + ((lines < at_least.size()) ? at_least[lines] : 0);
+		cout << setw(10) << sizes[i] << " bytes " << setw(8) << lines << " lines   miss ratio " << fixed << setprecision(4) << (double) misses / accesses << endl;
+	}
+	return 0;
+}
@@ -0,0 +1,233 @@
+#include "sim_pipe.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+/* =============================================================
+
+   SYNTHETIC WORKLOAD GENERATOR
+
+   ============================================================= */
+
+/*
+Emits an assembly program in the syntax of sim_pipe::load_program: a loop whose body is a random mix of
+ALU instructions, LW/SW and forward branches, with tunable hazard mix. The same parameters and seed always
+produce the same program.
+
+	workload_gen [-n body] [-i iterations] [-d distance] [-m memory] [-w stores] [-b branches] [-t taken]
+	             [-f footprint] [-s stride] [-r seed] [-o file]
+
+-n body		instructions in the loop body (default 20)
+-i iterations	iterations of the loop (default 100)
+-d distance	mean distance (in register writing instructions) between a source operand and the instruction
+		producing it; the distances are geometrically distributed (default 4, at most 27)
+-m memory	fraction of the body that is LW/SW (default 0.25)
+-w stores	fraction of the LW/SW that are SW (default 0.5)
+-b branches	fraction of the body that is forward branches skipping one instruction (default 0.1)
+-t taken	fraction of the branches that are taken (default 0.5); a branch always goes the same way
+-f footprint	bytes of data memory accessed, from address 0 (default 256, at least 4)
+-s stride	bytes between consecutive accesses (default 4)
+-r seed		seed of the random number generator (default 1)
+-o file		output file (default: standard output)
+
+Register usage: R0 = 0, R1 = iterations left, R2 = base address of the accesses of the current iteration,
+R3 = iterations left before the base address wraps around the footprint, R4-R31 = values.
+*/
+
+#define FIRST_VALUE_REGISTER 4
+#define NUM_VALUE_REGISTERS (NUM_GP_REGISTERS - FIRST_VALUE_REGISTER)
+
+typedef struct{
+	unsigned body;
+	unsigned iterations;
+	double distance;
+	double memory;
+	double stores;
+	double branches;
+	double taken;
+	unsigned footprint;
+	unsigned stride;
+	unsigned long long seed;
+} workload_params_t;
+
+/* xorshift64: the same sequence on every platform */
+static unsigned long long rng_state;
+
+static double rng_uniform(){
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* distance (>= 1) drawn from the geometric distribution of the given mean */
+static unsigned rng_distance(double mean){
+	unsigned d = 1;
+	double p = 1.0 / mean;
+	while (d < NUM_VALUE_REGISTERS - 1 && rng_uniform() >= p) d++;
+	return d;
+}
+
+static string reg(unsigned r){
+	ostringstream s;
+	s << "R" << r;
+	return s.str();
+}
+
+static void usage(){
+	cerr << "usage: workload_gen [-n body] [-i iterations] [-d distance] [-m memory] [-w stores] [-b branches] [-t taken] [-f footprint] [-s stride] [-r seed] [-o file]" << endl;
+	exit(-1);
+}
+
+/* generates the program; returns its instructions (labels are added by the caller) */
+static vector<string> generate(workload_params_t *p, map<unsigned, string> *labels){
+	vector<string> code;
+	rng_state = p->seed ? p->seed : 1;
+
+	// the types of the body instructions are drawn first: the number of accesses sizes the address wrap-around
+	vector<char> types; //A = ALU, L = LW, S = SW, B = branch
+	unsigned accesses = 0;
+	for (unsigned i=0; i<p->body; i++){
+		double x = rng_uniform();
+		char type = 'A';
+		if (x < p->branches && i+1 < p->body) type = 'B'; //a branch needs an instruction to skip
+		else if (x < p->branches + p->memory) type = (rng_uniform() < p->stores) ? 'S' : 'L';
+		if (type == 'L' || type == 'S') accesses++;
+		types.push_back(type);
+	}
+	// the k-th access of the body is at offset k*stride from the base address, which advances by the bytes covered
+	// by the body in every iteration and wraps around the footprint; if the body alone covers more than the
+	// footprint, the offsets wrap around it and the base address does not move
+	unsigned span = 0; //advance of the base address per iteration
+	unsigned wrap = 1; //iterations before the base address wraps around
+	if (accesses > 0 && (accesses-1) * p->stride + 4 <= p->footprint){
+		span = accesses * p->stride;
+		wrap = (p->footprint - 4 - (accesses-1) * p->stride) / span + 1;
+	}
+
+	// prologue: counters and initial values
+	code.push_back("XOR R0 R0 R0");
+	{
+		ostringstream s;
+		s << "ADDI R1 R0 " << p->iterations;
+		code.push_back(s.str());
+	}
+	code.push_back("ADDI R2 R0 0");
+	{
+		ostringstream s;
+		s << "ADDI R3 R0 " << wrap;
+		code.push_back(s.str());
+	}
+	for (unsigned r=0; r<NUM_VALUE_REGISTERS; r++){
+		ostringstream s;
+		s << "ADDI " << reg(FIRST_VALUE_REGISTER + r) << " R0 " << r+1;
+		code.push_back(s.str());
+	}
+
+	// body: value registers are written round robin, so the register written d writes ago is still live
+	unsigned loop = code.size();
+	(*labels)[loop] = "loop";
+	unsigned writes = 0;
+	unsigned access = 0;
+	static const char *alu_ops[5] = {"ADD", "SUB", "XOR", "ADDI", "SUBI"};
+	for (unsigned i=0; i<p->body; i++){
+		ostringstream s;
+		string dest = reg(FIRST_VALUE_REGISTER + writes % NUM_VALUE_REGISTERS);
+		string src1 = reg(FIRST_VALUE_REGISTER + (writes + NUM_VALUE_REGISTERS - rng_distance(p->distance)) % NUM_VALUE_REGISTERS);
+		string src2 = reg(FIRST_VALUE_REGISTER + (writes + NUM_VALUE_REGISTERS - rng_distance(p->distance)) % NUM_VALUE_REGISTERS);
+		switch(types[i]){
+			case 'A': {
+				unsigned op = (unsigned)(rng_uniform() * 5);
+				s << alu_ops[op] << " " << dest << " " << src1 << " ";
+				if (op < 3) s << src2;
+				else s << (unsigned)(rng_uniform() * 16);
+				writes++;
+				break;
+			}
+			case 'L':
+				s << "LW " << dest << " " << access++ * p->stride % (p->footprint - 3) << "(R2)";
+				writes++;
+				break;
+			case 'S':
+				s << "SW " << src1 << " " << access++ * p->stride % (p->footprint - 3) << "(R2)";
+				break;
+			case 'B': {
+				// taken and not taken branches read R0, so the outcome does not depend on the values
+				ostringstream label;
+				label << "L" << code.size() + 2;
+				(*labels)[code.size() + 2] = label.str();
+				s << ((rng_uniform() < p->taken) ? "BEQZ" : "BNEZ") << " R0 " << label.str();
+				break;
+			}
+		}
+		code.push_back(s.str());
+	}
+
+	// epilogue: next block of addresses (wrapping around the footprint) and loop branch
+	ostringstream s;
+	s << "ADDI R2 R2 " << span;
+	code.push_back(s.str());
+	code.push_back("SUBI R3 R3 1");
+	code.push_back("BGTZ R3 next");
+	code.push_back("ADDI R2 R0 0");
+	s.str("");
+	s << "ADDI R3 R0 " << wrap;
+	code.push_back(s.str());
+	(*labels)[code.size()] = "next";
+	code.push_back("SUBI R1 R1 1");
+	code.push_back("BGTZ R1 loop");
+	code.push_back("EOP");
+	return code;
+}
+
+int main(int argc, char **argv){
+	workload_params_t p = {20, 100, 4.0, 0.25, 0.5, 0.1, 0.5, 256, 4, 1};
+	const char *output = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:i:d:m:w:b:t:f:s:r:o:")) != -1){
+		switch(opt){
+			case 'n': p.body = strtoul(optarg, NULL, 0); break;
+			case 'i': p.iterations = strtoul(optarg, NULL, 0); break;
+			case 'd': p.distance = atof(optarg); break;
+			case 'm': p.memory = atof(optarg); break;
+			case 'w': p.stores = atof(optarg); break;
+			case 'b': p.branches = atof(optarg); break;
+			case 't': p.taken = atof(optarg); break;
+			case 'f': p.footprint = strtoul(optarg, NULL, 0); break;
+			case 's': p.stride = strtoul(optarg, NULL, 0); break;
+			case 'r': p.seed = strtoull(optarg, NULL, 0); break;
+			case 'o': output = optarg; break;
+			default: usage();
+		}
+	}
+	if (optind != argc || p.iterations == 0 || p.distance < 1 || p.memory < 0 || p.branches < 0 || p.memory + p.branches > 1 || p.stride == 0 || p.footprint < 4) usage();
+
+	map<unsigned, string> labels;
+	vector<string> code = generate(&p, &labels);
+	if (code.size() > PROGRAM_SIZE){
+		cerr << "error: the program has " << code.size() << " instructions, the instruction memory holds " << PROGRAM_SIZE << endl;
+		exit(-1);
+	}
+
+	ofstream fout;
+	if (output != NULL){
+		fout.open(output);
+		if (!fout.is_open()){
+			cerr << "error: open file " << output << " failed!" << endl;
+			exit(-1);
+		}
+	}
+	ostream &out = (output != NULL) ? fout : cout;
+	for (unsigned i=0; i<code.size(); i++){
+		if (labels.find(i) != labels.end()) out << labels[i] << ":\t";
+		out << code[i] << endl;
+	}
+	return 0;
+}